@@ -1,5 +1,8 @@
 #include "Animation.hpp"
 
+#include <algorithm>
+#include <span>
+
 static constexpr float axisFactor(Axis axis)
 {
     switch (axis)
@@ -16,15 +19,15 @@ static constexpr float axisFactor(Axis axis)
 
 AnimNodeData::AnimNodeData(const Position& pos)
 {
-    data[Axis::SCALE_X].push_back(std::make_pair(0.0f, pos.scaleX * axisFactor(Axis::SCALE_X)));
-    data[Axis::SCALE_Y].push_back(std::make_pair(0.0f, pos.scaleY * axisFactor(Axis::SCALE_Y)));
-    data[Axis::SCALE_Z].push_back(std::make_pair(0.0f, pos.scaleZ * axisFactor(Axis::SCALE_Z)));
-    data[Axis::ROT_X].push_back(std::make_pair(0.0f, pos.rotX * axisFactor(Axis::ROT_X)));
-    data[Axis::ROT_Y].push_back(std::make_pair(0.0f, pos.rotY * axisFactor(Axis::ROT_Y)));
-    data[Axis::ROT_Z].push_back(std::make_pair(0.0f, pos.rotZ * axisFactor(Axis::ROT_Z)));
-    data[Axis::POS_X].push_back(std::make_pair(0.0f, pos.posX));
-    data[Axis::POS_Y].push_back(std::make_pair(0.0f, pos.posY));
-    data[Axis::POS_Z].push_back(std::make_pair(0.0f, pos.posZ));
+    (*this)[Axis::SCALE_X].push(0.0f, pos.scaleX * axisFactor(Axis::SCALE_X));
+    (*this)[Axis::SCALE_Y].push(0.0f, pos.scaleY * axisFactor(Axis::SCALE_Y));
+    (*this)[Axis::SCALE_Z].push(0.0f, pos.scaleZ * axisFactor(Axis::SCALE_Z));
+    (*this)[Axis::ROT_X].push(0.0f, pos.rotX * axisFactor(Axis::ROT_X));
+    (*this)[Axis::ROT_Y].push(0.0f, pos.rotY * axisFactor(Axis::ROT_Y));
+    (*this)[Axis::ROT_Z].push(0.0f, pos.rotZ * axisFactor(Axis::ROT_Z));
+    (*this)[Axis::POS_X].push(0.0f, pos.posX);
+    (*this)[Axis::POS_Y].push(0.0f, pos.posY);
+    (*this)[Axis::POS_Z].push(0.0f, pos.posZ);
 }
 
 Animation::Animation(const MMDAnimation& anim)
@@ -37,11 +40,21 @@ Animation::Animation(const MMDAnimation& anim)
 
     do
     {
-        while (anim.instructions.size() > currentIndex && anim.instructions[currentIndex]->run(*this))
+        auto runInstruction = [&](const auto& instruction) { return run(anim, instruction); };
+        while (anim.instructions.size() > currentIndex && std::visit(runInstruction, anim.instructions[currentIndex]))
             currentIndex++;
 
-        mtnFrame++;
-        keyFrame++;
+        // nothing happens before the waiting instruction's frame, so skip straight to it or to the end
+        uint32_t nextFrame = anim.frameCount + 1;
+        if (anim.instructions.size() > currentIndex)
+        {
+            auto timecode = getTimecode(anim.instructions[currentIndex]);
+            if (timecode && *timecode > mtnFrame) nextFrame = std::min(nextFrame, *timecode);
+        }
+
+        auto frames = nextFrame > mtnFrame ? nextFrame - mtnFrame : 1;
+        mtnFrame += frames;
+        keyFrame += frames;
         keyFrameTime = (keyFrame - 1) / 20.0f;
     } while (mtnFrame <= anim.frameCount);
 
@@ -61,110 +74,132 @@ Animation::Animation(const MMDAnimation& anim)
 
 void Animation::setMomentum(const Axis axis, uint32_t node, float value)
 {
-    auto oldMomentum         = momentumData[node][axis];
-    momentumData[node][axis] = { keyFrame, value };
+    auto& momentum   = momentumData[node][static_cast<std::size_t>(axis)];
+    auto oldMomentum = momentum;
+    momentum         = { keyFrame, value };
 
     /* To be used when per-axis keyframe data is possible. E.g. with COLLADA, but not glTF
-    auto oldPos     = nodeData[node].data[axis].back();
-    auto frameCount = keyFrame - oldMomentum.first;
+    auto& track     = nodeData[node][axis];
+    auto frameCount = keyFrame - oldMomentum.keyFrame;
     auto timeCode   = (keyFrame - 1) / 20.0f;
 
-    nodeData[node].data[axis].push_back({ timeCode, oldPos.second + (oldMomentum.second * frameCount) });
+    track.push(timeCode, track.values.back() + (oldMomentum.value * frameCount));
     */
 }
 
 void Animation::updateData(const Axis axis, uint32_t node)
 {
-    auto oldMomentum               = momentumData[node][axis];
-    momentumData[node][axis].first = keyFrame;
-
-    auto oldPos     = nodeData[node].data[axis].back();
-    auto frameCount = keyFrame - oldMomentum.first;
+    auto& momentum    = momentumData[node][static_cast<std::size_t>(axis)];
+    auto frameCount   = keyFrame - momentum.keyFrame;
+    momentum.keyFrame = keyFrame;
 
-    nodeData[node].data[axis].push_back({ keyFrameTime, oldPos.second + (oldMomentum.second * frameCount) });
+    auto& track = nodeData[node][axis];
+    track.push(keyFrameTime, track.values.back() + (momentum.value * frameCount));
 }
 
-bool KeyframeInstruction::run(Animation& anim)
+bool Animation::run(const MMDAnimation& anim, const KeyframeInstruction& instruction)
 {
-    if (anim.mtnFrame != timecode) return false;
+    if (mtnFrame != instruction.timecode) return false;
 
     // update all axis for this keyframe, necessary when per-axis data is not allowed, as in glTF
-    for (uint32_t node = 0; node < anim.momentumData.size(); node++)
+    for (uint32_t node = 0; node < momentumData.size(); node++)
         for (int axis = 0; axis < 9; axis++)
-            anim.updateData((Axis)axis, node);
+            updateData((Axis)axis, node);
 
-    for (auto entry : entries)
-        for (auto value : entry.values)
-            anim.setMomentum(value.first, entry.affectedNode, value.second * axisFactor(value.first));
+    auto values = std::span(anim.keyframeValues).subspan(instruction.firstValue, instruction.valueCount);
+    for (auto& value : values)
+        setMomentum(value.axis, value.node, value.value);
 
     return true;
 }
 
-bool LoopStartInstruction::run(Animation& anim)
+bool Animation::run(const MMDAnimation& /*anim*/, const LoopStartInstruction& instruction)
 {
-    anim.jumpbackIndex = anim.currentIndex;
-    anim.loopCount     = loopCount;
+    jumpbackIndex = currentIndex;
+    loopCount     = instruction.loopCount;
 
     return true;
 }
 
-bool LoopEndInstruction::run(Animation& anim)
+bool Animation::run(const MMDAnimation& /*anim*/, const LoopEndInstruction& instruction)
 {
     // loop still running
-    if (anim.mtnFrame != timecode) return false;
+    if (mtnFrame != instruction.timecode) return false;
 
     // endless loop, animation ends here
-    if (anim.loopCount == 0xFF || anim.loopCount == 0x00)
+    if (loopCount == 0xFF || loopCount == 0x00)
     {
-        anim.endlessEnd   = (timecode - 1) / 20.0f;
-        anim.endlessStart = (newTime - 1) / 20.0f;
+        endlessEnd   = (instruction.timecode - 1) / 20.0f;
+        endlessStart = (instruction.newTime - 1) / 20.0f;
         return true;
     }
 
-    anim.mtnFrame = newTime;
-    anim.loopCount--;
+    mtnFrame = instruction.newTime;
+    loopCount--;
 
-    if (anim.loopCount != 0) anim.currentIndex = anim.jumpbackIndex;
+    if (loopCount != 0) currentIndex = jumpbackIndex;
 
     return true;
 }
 
-bool PlaySoundInstruction::run(Animation& anim)
+bool Animation::run(const MMDAnimation& /*anim*/, const PlaySoundInstruction& instruction)
 {
-    if (anim.mtnFrame != timecode) return false;
+    if (mtnFrame != instruction.timecode) return false;
 
-    anim.sound.emplace_back(anim.keyFrameTime, vabId, soundId);
+    sound.emplace_back(keyFrameTime, instruction.vabId, instruction.soundId);
     return true;
 }
 
-bool TextureInstruction::run(Animation& anim)
+bool Animation::run(const MMDAnimation& /*anim*/, const TextureInstruction& instruction)
 {
-    if (anim.mtnFrame != timecode) return false;
-
-    anim.texture.emplace_back(anim.keyFrameTime, srcX, srcY, destX, destY, width, height);
+    if (mtnFrame != instruction.timecode) return false;
+
+    texture.emplace_back(keyFrameTime,
+                         instruction.srcX,
+                         instruction.srcY,
+                         instruction.destX,
+                         instruction.destY,
+                         instruction.width,
+                         instruction.height);
     return true;
 }
 
-KeyframeEntry::KeyframeEntry(ReadBuffer& buffer)
+std::optional<uint32_t> getTimecode(const Instruction& instruction)
 {
-    uint16_t instruction = buffer.read<uint16_t>();
-    enabledAxis          = (instruction & 0x7FC0) >> 6;
-    affectedNode         = instruction & 0x3F;
-    scale                = buffer.read<uint16_t>();
-
-    for (int32_t i = 8; i >= 0; i--)
-    {
-        if ((enabledAxis & (1 << i)) == 0) continue;
-        values.push_back(std::make_pair(static_cast<Axis>(8 - i), buffer.read<int16_t>() / (float)scale));
-    }
+    return std::visit(
+        [](const auto& value) -> std::optional<uint32_t>
+        {
+            if constexpr (requires { value.timecode; })
+                return value.timecode;
+            else
+                return {};
+        },
+        instruction);
 }
 
-KeyframeInstruction::KeyframeInstruction(uint32_t instruction, ReadBuffer& buffer)
+KeyframeInstruction::KeyframeInstruction(uint32_t instruction, ReadBuffer& buffer, std::vector<KeyframeValue>& values)
 {
-    timecode = instruction & 0x0FFF;
+    timecode   = instruction & 0x0FFF;
+    firstValue = static_cast<uint32_t>(values.size());
 
     while (buffer.peek<uint16_t>() & 0x8000)
-        entries.emplace_back(buffer);
+    {
+        uint16_t entry       = buffer.read<uint16_t>();
+        uint16_t enabledAxis = (entry & 0x7FC0) >> 6;
+        uint8_t affectedNode = entry & 0x3F;
+        uint16_t scale       = buffer.read<uint16_t>();
+
+        for (int32_t i = 8; i >= 0; i--)
+        {
+            if ((enabledAxis & (1 << i)) == 0) continue;
+
+            auto axis  = static_cast<Axis>(8 - i);
+            auto value = buffer.read<int16_t>() / (float)scale;
+            values.push_back({ affectedNode, axis, value * axisFactor(axis) });
+        }
+    }
+
+    valueCount = static_cast<uint32_t>(values.size()) - firstValue;
 }
 
 LoopEndInstruction::LoopEndInstruction(uint32_t instruction, ReadBuffer& buffer)
@@ -191,7 +226,7 @@ TextureInstruction::TextureInstruction(uint32_t instruction, ReadBuffer& buffer)
     destX    = buffer.read<uint8_t>();
 }
 
-void TextureInstruction::handleTexture(CLUTMap& clutMap)
+void TextureInstruction::handleTexture(CLUTMap& clutMap) const
 {
     for (auto& entry : clutMap.texturePages)
     {
@@ -238,27 +273,27 @@ MMDAnimation::MMDAnimation(uint32_t id, ReadBuffer& buffer, std::size_t boneCoun
         {
             case 0x0000: // keyframe
             {
-                instructions.emplace_back(new KeyframeInstruction(instruction, buffer));
+                instructions.emplace_back(std::in_place_type<KeyframeInstruction>, instruction, buffer, keyframeValues);
                 break;
             }
             case 0x1000: // loop start
             {
-                instructions.emplace_back(new LoopStartInstruction(instruction));
+                instructions.emplace_back(std::in_place_type<LoopStartInstruction>, instruction);
                 break;
             }
             case 0x2000: // loop end
             {
-                instructions.emplace_back(new LoopEndInstruction(instruction, buffer));
+                instructions.emplace_back(std::in_place_type<LoopEndInstruction>, instruction, buffer);
                 break;
             }
             case 0x3000: // change texture
             {
-                instructions.emplace_back(new TextureInstruction(instruction, buffer));
+                instructions.emplace_back(std::in_place_type<TextureInstruction>, instruction, buffer);
                 break;
             }
             case 0x4000: // play sound
             {
-                instructions.emplace_back(new PlaySoundInstruction(instruction, buffer));
+                instructions.emplace_back(std::in_place_type<PlaySoundInstruction>, instruction, buffer);
                 break;
             }
         }
@@ -5,13 +5,11 @@
 
 #include <stdint.h>
 
-#include <map>
-#include <memory>
+#include <array>
+#include <optional>
+#include <variant>
 #include <vector>
 
-// forward declaration
-class Animation;
-
 struct Position
 {
     int16_t scaleX = 0x1000;
@@ -40,69 +38,51 @@ enum class Axis
     POS_Z,
 };
 
-class Instruction
-{
-public:
-    virtual ~Instruction()                      = default;
-    Instruction()                               = default;
-    Instruction(const Instruction&)             = delete; // can't copy
-    Instruction& operator=(const Instruction&&) = delete; // can't copy
-
-    virtual bool run(Animation& anim) = 0;
-    virtual void handleTexture(CLUTMap& clutMap){};
-};
+constexpr std::size_t AXIS_COUNT = 9;
 
-struct KeyframeEntry
+// momentum of a single axis set by a keyframe, already converted to units per frame
+struct KeyframeValue
 {
-    uint16_t enabledAxis;
-    uint8_t affectedNode;
-    uint16_t scale;
-    std::vector<std::pair<Axis, float>> values{};
-
-    KeyframeEntry(ReadBuffer& buffer);
+    uint8_t node;
+    Axis axis;
+    float value;
 };
 
-class KeyframeInstruction : public Instruction
+struct KeyframeInstruction
 {
     uint32_t timecode;
-    std::vector<KeyframeEntry> entries;
+    // range of the animation's keyframe values set by this keyframe
+    uint32_t firstValue;
+    uint32_t valueCount;
 
-public:
-    KeyframeInstruction(uint32_t instruction, ReadBuffer& buffer);
-    bool run(Animation& anim) override;
+    KeyframeInstruction(uint32_t instruction, ReadBuffer& buffer, std::vector<KeyframeValue>& values);
 };
 
-class LoopStartInstruction : public Instruction
+struct LoopStartInstruction
 {
     uint32_t loopCount;
 
-public:
     LoopStartInstruction(uint32_t instruction) { loopCount = instruction & 0x00FF; }
-    bool run(Animation& anim) override;
 };
 
-class LoopEndInstruction : public Instruction
+struct LoopEndInstruction
 {
     uint32_t timecode;
     uint32_t newTime;
 
-public:
     LoopEndInstruction(uint32_t instruction, ReadBuffer& buffer);
-    bool run(Animation& anim) override;
 };
 
-class PlaySoundInstruction : public Instruction
+struct PlaySoundInstruction
 {
     uint32_t timecode;
     uint8_t vabId;
     uint8_t soundId;
 
-public:
     PlaySoundInstruction(uint32_t instruction, ReadBuffer& buffer);
-    bool run(Animation& anim) override;
 };
 
-class TextureInstruction : public Instruction
+struct TextureInstruction
 {
     uint32_t timecode;
     uint8_t srcX;
@@ -112,19 +92,28 @@ class TextureInstruction : public Instruction
     uint8_t destX;
     uint8_t destY;
 
-public:
     TextureInstruction(uint32_t instruction, ReadBuffer& buffer);
-    bool run(Animation& anim) override;
-    void handleTexture(CLUTMap& clutMap) override;
+    void handleTexture(CLUTMap& clutMap) const;
 };
 
+using Instruction = std::variant<KeyframeInstruction,
+                                 LoopStartInstruction,
+                                 LoopEndInstruction,
+                                 PlaySoundInstruction,
+                                 TextureInstruction>;
+
+// frame the instruction waits for before it runs, instructions without one run immediately
+std::optional<uint32_t> getTimecode(const Instruction& instruction);
+
 class MMDAnimation
 {
 public:
     uint32_t frameCount;
     uint32_t id;
     std::vector<Position> initialPositions;
-    std::vector<std::shared_ptr<Instruction>> instructions;
+    std::vector<Instruction> instructions;
+    // values of all keyframe instructions, in order
+    std::vector<KeyframeValue> keyframeValues;
 
     MMDAnimation(uint32_t id, ReadBuffer& buffer, std::size_t boneCount);
     MMDAnimation(uint32_t id);
@@ -139,10 +128,28 @@ public:
     MMDAnimations();
 };
 
+// keys of a single axis, times and values are stored in separate contiguous arrays
+struct AnimTrack
+{
+    std::vector<float> times;
+    std::vector<float> values;
+
+    void push(float time, float value)
+    {
+        times.push_back(time);
+        values.push_back(value);
+    }
+
+    std::size_t size() const { return times.size(); }
+};
+
 struct AnimNodeData
 {
-    std::map<Axis, std::vector<std::pair<float, float>>> data;
+    std::array<AnimTrack, AXIS_COUNT> tracks;
     AnimNodeData(const Position& pos);
+
+    AnimTrack& operator[](Axis axis) { return tracks[static_cast<std::size_t>(axis)]; }
+    const AnimTrack& operator[](Axis axis) const { return tracks[static_cast<std::size_t>(axis)]; }
 };
 
 struct TextureAnimation
@@ -165,7 +172,14 @@ struct SoundAnimation
 
 class Animation
 {
-    using MomentumData = std::map<Axis, std::pair<uint32_t, float>>;
+    // change per frame of an axis, starting at the given keyframe
+    struct Momentum
+    {
+        uint32_t keyFrame = 0;
+        float value       = 0.0f;
+    };
+
+    using MomentumData = std::array<Momentum, AXIS_COUNT>;
 
 private:
     std::vector<AnimNodeData> nodeData;
@@ -182,12 +196,12 @@ private:
     void setMomentum(const Axis axis, uint32_t node, float value);
     void updateData(const Axis axis, uint32_t node);
 
-    friend Instruction;
-    friend KeyframeInstruction;
-    friend LoopStartInstruction;
-    friend LoopEndInstruction;
-    friend PlaySoundInstruction;
-    friend TextureInstruction;
+    // each returns whether the instruction ran, or has to wait for a later frame
+    bool run(const MMDAnimation& anim, const KeyframeInstruction& instruction);
+    bool run(const MMDAnimation& anim, const LoopStartInstruction& instruction);
+    bool run(const MMDAnimation& anim, const LoopEndInstruction& instruction);
+    bool run(const MMDAnimation& anim, const PlaySoundInstruction& instruction);
+    bool run(const MMDAnimation& anim, const TextureInstruction& instruction);
 
 public:
     // start of endless looping, as time code
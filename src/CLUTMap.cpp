@@ -56,7 +56,7 @@ void CLUTMap::applyModel(const Model& model)
 
     for (auto& anim : model.anims.anims)
         for (auto& instr : anim.instructions)
-            instr->handleTexture(*this);
+            if (auto texture = std::get_if<TextureInstruction>(&instr)) texture->handleTexture(*this);
 
     updateBlocks();
 }
\ No newline at end of file
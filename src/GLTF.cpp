@@ -4,11 +4,25 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
 #include "GLTF.hpp"
+#include "PoseEvaluator.hpp"
+
+#include <tiny_gltf.h>
+
+#include "utils/Hash.hpp"
+#include "utils/KeyframeReducer.hpp"
+#include "utils/MeshOptimizer.hpp"
+#include "utils/OrderedLog.hpp"
+#include "utils/SinCos.hpp"
 
 #include <algorithm>
+#include <array>
 #include <format>
+#include <fstream>
+#include <limits>
 #include <iostream>
 #include <numbers>
+#include <span>
+#include <unordered_map>
 
 bool hasValidNormals(const Mesh& mesh, const Face& face)
 {
@@ -28,350 +42,832 @@ struct Quaternion
     float w;
 
     Quaternion() = default;
-    Quaternion(FVector angles)
+    Quaternion(float x, float y, float z, float w)
+        : x(x)
+        , y(y)
+        , z(z)
+        , w(w)
     {
-        float c1 = std::cos((angles.x * std::numbers::pi / 180.0f) * 0.5f);
-        float s1 = std::sin((angles.x * std::numbers::pi / 180.0f) * 0.5f);
-        float c2 = std::cos((angles.y * std::numbers::pi / 180.0f) * 0.5f);
-        float s2 = std::sin((angles.y * std::numbers::pi / 180.0f) * 0.5f);
-        float c3 = std::cos((angles.z * std::numbers::pi / 180.0f) * 0.5f);
-        float s3 = std::sin((angles.z * std::numbers::pi / 180.0f) * 0.5f);
-
-        this->w = c1 * c2 * c3 - s1 * s2 * s3;
-        this->x = s1 * c2 * c3 + c1 * s2 * s3;
-        this->y = -s1 * c2 * s3 + c1 * s2 * c3;
-        this->z = c1 * c2 * s3 + s1 * s2 * c3;
     }
 };
 
-template<typename T> std::size_t push(std::vector<T>& vec, T& val)
+// integer vertex attributes for KHR_mesh_quantization, padded so every vertex starts on a 4 byte boundary
+struct ShortVector
 {
-    auto id = vec.size();
-    vec.push_back(val);
-    return id;
-}
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    int16_t pad = 0;
+};
+
+struct ByteTexCoord
+{
+    uint8_t u;
+    uint8_t v;
+    uint16_t pad = 0;
+};
+
+struct ShortTexCoord
+{
+    uint16_t u;
+    uint16_t v;
+};
 
-template<typename T> T myMin(T& a, T& b) { return std::min(a, b); }
+// joints and weights of skinned vertices, each vertex uses only the first one
+template<typename T> struct Vector4
+{
+    T x;
+    T y;
+    T z;
+    T w;
+};
 
-template<typename T> T myMax(T& a, T& b) { return std::max(a, b); }
+// component type and count of the element types accessors are built from
+template<typename T> struct AccessorTraits;
 
-template<typename T> void push_to_vector(std::vector<double>& vec, T val) { vec.push_back(val); }
+template<> struct AccessorTraits<float>
+{
+    using Component                    = float;
+    static constexpr std::size_t count = 1;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    static constexpr int type          = TINYGLTF_TYPE_SCALAR;
+};
 
-template<> void push_to_vector(std::vector<double>& vec, FVector val)
+template<> struct AccessorTraits<uint16_t>
 {
-    vec.push_back(val.x);
-    vec.push_back(val.y);
-    vec.push_back(val.z);
-}
+    using Component                    = uint16_t;
+    static constexpr std::size_t count = 1;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+    static constexpr int type          = TINYGLTF_TYPE_SCALAR;
+};
 
-template<> void push_to_vector(std::vector<double>& vec, Quaternion val)
+template<> struct AccessorTraits<uint32_t>
 {
-    vec.push_back(val.x);
-    vec.push_back(val.y);
-    vec.push_back(val.z);
-    vec.push_back(val.w);
-}
+    using Component                    = uint32_t;
+    static constexpr std::size_t count = 1;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    static constexpr int type          = TINYGLTF_TYPE_SCALAR;
+};
 
-template<> void push_to_vector(std::vector<double>& vec, ColorRGB val)
+template<> struct AccessorTraits<TexCoord>
 {
-    vec.push_back(val.r);
-    vec.push_back(val.g);
-    vec.push_back(val.b);
+    using Component                    = float;
+    static constexpr std::size_t count = 2;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC2;
+};
+
+template<> struct AccessorTraits<FVector>
+{
+    using Component                    = float;
+    static constexpr std::size_t count = 3;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC3;
+};
+
+template<> struct AccessorTraits<Quaternion>
+{
+    using Component                    = float;
+    static constexpr std::size_t count = 4;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC4;
+};
+
+template<> struct AccessorTraits<ShortVector>
+{
+    using Component                    = int16_t;
+    static constexpr std::size_t count = 3;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_SHORT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC3;
+};
+
+template<> struct AccessorTraits<ByteTexCoord>
+{
+    using Component                    = uint8_t;
+    static constexpr std::size_t count = 2;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    static constexpr int type          = TINYGLTF_TYPE_VEC2;
+};
+
+template<> struct AccessorTraits<ShortTexCoord>
+{
+    using Component                    = uint16_t;
+    static constexpr std::size_t count = 2;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC2;
+};
+
+// the unused padding byte is skipped by the stride
+template<> struct AccessorTraits<ColorRGB>
+{
+    using Component                    = uint8_t;
+    static constexpr std::size_t count = 3;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    static constexpr int type          = TINYGLTF_TYPE_VEC3;
+};
+
+template<> struct AccessorTraits<Vector4<uint8_t>>
+{
+    using Component                    = uint8_t;
+    static constexpr std::size_t count = 4;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    static constexpr int type          = TINYGLTF_TYPE_VEC4;
+};
+
+template<> struct AccessorTraits<Vector4<uint16_t>>
+{
+    using Component                    = uint16_t;
+    static constexpr std::size_t count = 4;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+    static constexpr int type          = TINYGLTF_TYPE_VEC4;
+};
+
+template<> struct AccessorTraits<Matrix4>
+{
+    using Component                    = float;
+    static constexpr std::size_t count = 16;
+    static constexpr int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    static constexpr int type          = TINYGLTF_TYPE_MAT4;
+};
+
+template<typename T> struct Bounds
+{
+    std::array<typename AccessorTraits<T>::Component, AccessorTraits<T>::count> min;
+    std::array<typename AccessorTraits<T>::Component, AccessorTraits<T>::count> max;
+};
+
+// per component min/max in a single pass over the raw components, simple enough for the compiler to vectorize
+template<typename T> Bounds<T> computeBounds(std::span<const T> data)
+{
+    using Component       = typename AccessorTraits<T>::Component;
+    constexpr auto count  = AccessorTraits<T>::count;
+    constexpr auto stride = sizeof(T) / sizeof(Component);
+    static_assert(sizeof(T) % sizeof(Component) == 0);
+
+    auto components = reinterpret_cast<const Component*>(data.data());
+
+    Bounds<T> bounds;
+    std::copy_n(components, count, bounds.min.begin());
+    std::copy_n(components, count, bounds.max.begin());
+
+    for (std::size_t i = 0; i < data.size(); i++)
+    {
+        auto element = components + i * stride;
+        for (std::size_t c = 0; c < count; c++)
+        {
+            bounds.min[c] = std::min(bounds.min[c], element[c]);
+            bounds.max[c] = std::max(bounds.max[c], element[c]);
+        }
+    }
+
+    return bounds;
 }
 
-template<> void push_to_vector(std::vector<double>& vec, TexCoord val)
+std::string to_string(ModelType type)
 {
-    vec.push_back(val.u);
-    vec.push_back(val.v);
+    switch (type)
+    {
+        case ModelType::DIGIMON: return "digimon";
+        case ModelType::DOOR: return "door";
+        default: return "undefined";
+    }
 }
 
-template<> FVector myMin(FVector& a, FVector& b)
+std::string to_string(OutputFormat format)
 {
-    FVector out;
-    out.x = std::min(a.x, b.x);
-    out.y = std::min(a.y, b.y);
-    out.z = std::min(a.z, b.z);
-    return out;
+    switch (format)
+    {
+        case OutputFormat::GLTF: return "gltf";
+        case OutputFormat::GLB: return "glb";
+        case OutputFormat::SEPARATE: return "separate";
+        default: return "undefined";
+    }
 }
 
-template<> FVector myMax(FVector& a, FVector& b)
+std::string getExtension(OutputFormat format)
 {
-    FVector out;
-    out.x = std::max(a.x, b.x);
-    out.y = std::max(a.y, b.y);
-    out.z = std::max(a.z, b.z);
-    return out;
+    switch (format)
+    {
+        case OutputFormat::GLB: return ".glb";
+        default: return ".gltf";
+    }
 }
 
-template<> Quaternion myMin(Quaternion& a, Quaternion& b)
+TextureStore::TextureStore(std::filesystem::path directory)
+    : directory(directory)
 {
-    Quaternion out;
-    out.w = std::min(a.w, b.w);
-    out.x = std::min(a.x, b.x);
-    out.y = std::min(a.y, b.y);
-    out.z = std::min(a.z, b.z);
-    return out;
 }
 
-template<> Quaternion myMax(Quaternion& a, Quaternion& b)
+std::optional<std::filesystem::path> TextureStore::store(const std::vector<unsigned char>& rgba,
+                                                         int32_t width,
+                                                         int32_t height)
 {
-    Quaternion out;
-    out.w = std::max(a.w, b.w);
-    out.x = std::max(a.x, b.x);
-    out.y = std::max(a.y, b.y);
-    out.z = std::max(a.z, b.z);
-    return out;
+    auto hash = Hash().updateValue(width).updateValue(height).update(rgba).toString();
+    auto path = directory / (hash + ".png");
+
+    std::unique_lock lock(mutex);
+
+    auto existing = textures.find(hash);
+    if (existing != textures.end())
+    {
+        auto future = existing->second;
+        lock.unlock();
+        return future.get() ? std::optional(path) : std::nullopt;
+    }
+
+    std::promise<bool> promise;
+    textures.emplace(hash, promise.get_future().share());
+    lock.unlock();
+
+    // the name depends on the content, so a file left by a previous run can be used as is
+    bool success = std::filesystem::exists(path);
+    if (!success)
+    {
+        // write to a temporary file first, so an aborted run doesn't leave a broken image behind
+        std::error_code error;
+        auto tempPath = path;
+        tempPath += ".tmp";
+        std::filesystem::create_directories(directory, error);
+        success = stbi_write_png(tempPath.string().c_str(), width, height, 4, rgba.data(), 0) != 0;
+        if (success) std::filesystem::rename(tempPath, path, error);
+        success = success && !error;
+    }
+
+    promise.set_value(success);
+    return success ? std::optional(path) : std::nullopt;
 }
 
-template<> ColorRGB myMin(ColorRGB& a, ColorRGB& b)
+TextureAtlas::TextureAtlas(std::filesystem::path filename,
+                           std::size_t slotCount,
+                           uint32_t slotWidth,
+                           uint32_t slotHeight)
+    : filename(filename)
+    , slotWidth(slotWidth)
+    , slotHeight(slotHeight)
 {
-    ColorRGB out;
-    out.r = std::min(a.r, b.r);
-    out.g = std::min(a.g, b.g);
-    out.b = std::min(a.b, b.b);
-    return out;
+    // as close to a square as possible
+    auto count = static_cast<uint32_t>(std::max<std::size_t>(slotCount, 1));
+    columns    = static_cast<uint32_t>(std::ceil(std::sqrt(count * static_cast<double>(slotHeight) / slotWidth)));
+    columns    = std::clamp(columns, 1u, count);
+    rows       = (count + columns - 1) / columns;
+
+    auto [width, height] = getSize();
+    rgba.assign(static_cast<std::size_t>(width) * height * 4, 0);
+
+    // keep the slots of models that don't get exported this time
+    int32_t existingWidth;
+    int32_t existingHeight;
+    int32_t channels;
+    auto existing = stbi_load(filename.string().c_str(), &existingWidth, &existingHeight, &channels, 4);
+    if (existing == nullptr) return;
+
+    if (existingWidth == static_cast<int32_t>(width) && existingHeight == static_cast<int32_t>(height))
+        std::copy(existing, existing + rgba.size(), rgba.begin());
+    stbi_image_free(existing);
 }
-template<> ColorRGB myMax(ColorRGB& a, ColorRGB& b)
+
+std::pair<uint32_t, uint32_t> TextureAtlas::getOffset(std::size_t slot) const
 {
-    ColorRGB out;
-    out.r = std::max(a.r, b.r);
-    out.g = std::max(a.g, b.g);
-    out.b = std::max(a.b, b.b);
-    return out;
+    auto index = static_cast<uint32_t>(slot);
+    return { (index % columns) * slotWidth, (index / columns) * slotHeight };
 }
 
-template<> TexCoord myMin(TexCoord& a, TexCoord& b)
+bool TextureAtlas::place(std::size_t slot,
+                         const std::vector<unsigned char>& image,
+                         int32_t width,
+                         int32_t height)
 {
-    TexCoord out;
-    out.u = std::min(a.u, b.u);
-    out.v = std::min(a.v, b.v);
-    return out;
+    if (slot >= static_cast<std::size_t>(columns) * rows) return false;
+    if (width > static_cast<int32_t>(slotWidth) || height > static_cast<int32_t>(slotHeight)) return false;
+
+    auto [offsetX, offsetY] = getOffset(slot);
+    auto atlasWidth         = getSize().first;
+
+    std::lock_guard lock(mutex);
+    for (int32_t y = 0; y < height; y++)
+    {
+        auto source = image.begin() + static_cast<std::size_t>(y) * width * 4;
+        auto target = (static_cast<std::size_t>(offsetY + y) * atlasWidth + offsetX) * 4;
+        std::copy(source, source + width * 4, rgba.begin() + target);
+    }
+
+    return true;
 }
 
-template<> TexCoord myMax(TexCoord& a, TexCoord& b)
+bool TextureAtlas::save()
 {
-    TexCoord out;
-    out.u = std::max(a.u, b.u);
-    out.v = std::max(a.v, b.v);
-    return out;
+    std::lock_guard lock(mutex);
+    auto [width, height] = getSize();
+
+    // write to a temporary file first, so an aborted run doesn't leave a broken image behind
+    std::error_code error;
+    auto tempPath = filename;
+    tempPath += ".tmp";
+    std::filesystem::create_directories(filename.parent_path(), error);
+    if (stbi_write_png(tempPath.string().c_str(), width, height, 4, rgba.data(), 0) == 0) return false;
+
+    std::filesystem::rename(tempPath, filename, error);
+    return !error;
 }
 
-std::string to_string(ModelType type)
+std::string getAccessorType(int type)
 {
     switch (type)
     {
-        case ModelType::DIGIMON: return "digimon";
-        case ModelType::DOOR: return "door";
+        case TINYGLTF_TYPE_SCALAR: return "SCALAR";
+        case TINYGLTF_TYPE_VEC2: return "VEC2";
+        case TINYGLTF_TYPE_VEC3: return "VEC3";
+        case TINYGLTF_TYPE_VEC4: return "VEC4";
+        case TINYGLTF_TYPE_MAT4: return "MAT4";
         default: return "undefined";
     }
 }
 
 void GLTFExporter::buildAssetEntry(ModelType type)
 {
-    tinygltf::Value::Object extras;
-    extras.emplace("model_type", to_string(type));
-
-    model.asset.version   = "2.0";
-    model.asset.generator = std::format("{} {}", PROJECT_NAME, PROJECT_VERSION);
-    model.asset.extras    = tinygltf::Value(extras);
+    auto& asset                  = writer.getDocument()["asset"];
+    asset["version"]             = "2.0";
+    asset["generator"]           = std::format("{} {}", PROJECT_NAME, PROJECT_VERSION);
+    asset["extras"]["model_type"] = to_string(type);
 }
 
-std::size_t GLTFExporter::buildPrimitiveVertex(const Mesh& mesh, std::vector<Face> faces)
+static PrimitiveData buildPrimitiveData(const Mesh& mesh, MaterialMode material, const std::vector<Face>& faces)
 {
-    std::vector<FVector> data;
+    PrimitiveData data(material);
 
     for (auto& face : faces)
     {
-        data.push_back(mesh.vertices[face.v1].convertToFixedPoint(0));
-        data.push_back(mesh.vertices[face.v2].convertToFixedPoint(0));
-        data.push_back(mesh.vertices[face.v3].convertToFixedPoint(0));
+        data.positions.push_back(mesh.vertices[face.v1].convertToFixedPoint(0));
+        data.positions.push_back(mesh.vertices[face.v2].convertToFixedPoint(0));
+        data.positions.push_back(mesh.vertices[face.v3].convertToFixedPoint(0));
+
+        if (material.type != MaterialType::NO_LIGHT)
+        {
+            if (hasValidNormals(mesh, face))
+            {
+                data.normals.push_back(mesh.normals[face.n1]);
+                data.normals.push_back(mesh.normals[face.n2]);
+                data.normals.push_back(mesh.normals[face.n3]);
+            }
+            else
+            {
+                data.normals.push_back({ 0.0f, 1.0f, 0.0f });
+                data.normals.push_back({ 0.0f, 1.0f, 0.0f });
+                data.normals.push_back({ 0.0f, 1.0f, 0.0f });
+                taskLog() << "Source model contains invalid normal data, using empty fallback values." << std::endl;
+            }
+        }
+
+        if (material.type != MaterialType::TEXTURE)
+        {
+            data.colors.push_back(face.color1);
+            data.colors.push_back(face.color2);
+            data.colors.push_back(face.color3);
+        }
+
+        if (material.type != MaterialType::COLOR)
+        {
+            data.uvs.push_back(face.uv1);
+            data.uvs.push_back(face.uv2);
+            data.uvs.push_back(face.uv3);
+            data.texturePages.insert(data.texturePages.end(), 3, face.texturePage);
+        }
     }
 
-    return buildAccessor(data, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+    return data;
 }
 
-std::size_t GLTFExporter::buildPrimitiveNormal(const Mesh& mesh, std::vector<Face> faces)
+// a vertex with all of its attributes, absent attributes are left zeroed
+struct VertexKey
 {
-    std::vector<FVector> data;
+    FVector position{};
+    FVector normal{};
+    ColorRGB color{};
+    UVCoord uv{};
+    uint8_t texturePage = 0;
 
-    for (auto& face : faces)
+    friend bool operator==(const VertexKey& l, const VertexKey& r)
+    {
+        auto tie = [](const VertexKey& key)
+        {
+            return std::tie(key.position.x,
+                            key.position.y,
+                            key.position.z,
+                            key.normal.x,
+                            key.normal.y,
+                            key.normal.z,
+                            key.color.r,
+                            key.color.g,
+                            key.color.b,
+                            key.uv.u,
+                            key.uv.v,
+                            key.texturePage);
+        };
+        return tie(l) == tie(r);
+    }
+};
+
+struct VertexKeyHash
+{
+    std::size_t operator()(const VertexKey& key) const
+    {
+        Hash hash;
+        hash.updateValue(key.position).updateValue(key.normal);
+        hash.updateValue(key.color.r).updateValue(key.color.g).updateValue(key.color.b);
+        hash.updateValue(key.uv).updateValue(key.texturePage);
+        return hash.get();
+    }
+};
+
+// merges identical vertices of a triangle soup and references them through an index list instead
+static PrimitiveData indexPrimitiveData(const PrimitiveData& soup)
+{
+    PrimitiveData data(soup.material);
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexMap;
+    vertexMap.reserve(soup.positions.size());
+    data.indices.reserve(soup.positions.size());
+
+    for (std::size_t i = 0; i < soup.positions.size(); i++)
     {
-        if (hasValidNormals(mesh, face))
+        VertexKey key{ .position = soup.positions[i] };
+        if (!soup.normals.empty()) key.normal = soup.normals[i];
+        if (!soup.colors.empty()) key.color = soup.colors[i];
+        if (!soup.uvs.empty())
         {
-            data.push_back(mesh.normals[face.n1]);
-            data.push_back(mesh.normals[face.n2]);
-            data.push_back(mesh.normals[face.n3]);
+            key.uv          = soup.uvs[i];
+            key.texturePage = soup.texturePages[i];
         }
-        else
+
+        auto [entry, inserted] = vertexMap.try_emplace(key, static_cast<uint32_t>(data.positions.size()));
+        data.indices.push_back(entry->second);
+        if (!inserted) continue;
+
+        data.positions.push_back(soup.positions[i]);
+        if (!soup.normals.empty()) data.normals.push_back(soup.normals[i]);
+        if (!soup.colors.empty()) data.colors.push_back(soup.colors[i]);
+        if (!soup.uvs.empty())
         {
-            data.push_back({ 0.0f, 1.0f, 0.0f });
-            data.push_back({ 0.0f, 1.0f, 0.0f });
-            data.push_back({ 0.0f, 1.0f, 0.0f });
-            std::cout << "Source model contains invalid normal data, using empty fallback values." << std::endl;
+            data.uvs.push_back(soup.uvs[i]);
+            data.texturePages.push_back(soup.texturePages[i]);
         }
     }
 
-    return buildAccessor(data, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+    return data;
 }
 
-std::size_t GLTFExporter::buildPrimitiveColor(std::vector<Face> faces)
+template<typename T> static void remapVertices(std::vector<T>& attribute, std::span<const uint32_t> remap)
 {
-    std::vector<ColorRGB> data;
+    if (attribute.empty()) return;
 
-    for (auto& face : faces)
+    std::vector<T> result(attribute.size());
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < remap.size(); i++)
     {
-        data.push_back(face.color1);
-        data.push_back(face.color2);
-        data.push_back(face.color3);
+        if (remap[i] == std::numeric_limits<uint32_t>::max()) continue;
+
+        result[remap[i]] = attribute[i];
+        count++;
     }
 
-    return buildAccessor(data,
-                         TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE,
-                         TINYGLTF_TYPE_VEC3,
-                         TINYGLTF_TARGET_ARRAY_BUFFER,
-                         true);
+    result.resize(count);
+    attribute = std::move(result);
 }
 
-std::size_t GLTFExporter::buildPrimitiveTexcoord(std::vector<Face> faces)
+static void optimizePrimitiveData(PrimitiveData& data, VertexCacheStats* stats)
 {
-    std::vector<TexCoord> data;
+    auto vertexCount  = data.positions.size();
+    auto missesBefore = countCacheMisses(data.indices, vertexCount);
+
+    optimizeVertexCache(data.indices, vertexCount);
+    auto remap = optimizeVertexFetch(data.indices, vertexCount);
+
+    remapVertices(data.positions, remap);
+    remapVertices(data.normals, remap);
+    remapVertices(data.colors, remap);
+    remapVertices(data.uvs, remap);
+    remapVertices(data.texturePages, remap);
+
+    if (!stats) return;
+    stats->triangles += data.indices.size() / 3;
+    stats->missesBefore += missesBefore;
+    stats->missesAfter += countCacheMisses(data.indices, data.positions.size());
+}
 
-    for (auto& face : faces)
+// appends the vertices of a primitive with the same material, offsetting its indices to the appended vertices
+static void appendPrimitive(PrimitiveData& target, const PrimitiveData& source)
+{
+    auto offset = static_cast<uint32_t>(target.positions.size());
+
+    target.positions.insert(target.positions.end(), source.positions.begin(), source.positions.end());
+    target.normals.insert(target.normals.end(), source.normals.begin(), source.normals.end());
+    target.colors.insert(target.colors.end(), source.colors.begin(), source.colors.end());
+    target.uvs.insert(target.uvs.end(), source.uvs.begin(), source.uvs.end());
+    target.texturePages.insert(target.texturePages.end(), source.texturePages.begin(), source.texturePages.end());
+    target.joints.insert(target.joints.end(), source.joints.begin(), source.joints.end());
+
+    for (auto index : source.indices)
+        target.indices.push_back(index + offset);
+}
+
+std::vector<MeshData> buildMeshData(const Model& model, const ExportOptions& options, VertexCacheStats* stats)
+{
+    std::vector<MeshData> meshes;
+
+    auto finishPrimitive = [&](PrimitiveData& primitive)
+    {
+        if (options.indexed) primitive = indexPrimitiveData(primitive);
+        if (options.indexed && options.optimizeMeshes) optimizePrimitiveData(primitive, stats);
+    };
+
+    // objects of static models never move relative to each other, so all of them can share primitives
+    bool merge = options.mergeStatic && model.skeleton.empty();
+    std::map<MaterialMode, PrimitiveData> merged;
+
+    for (const Mesh& mesh : model.meshes)
     {
-        auto offset = (face.texturePage - tim.getPixelX() / 64) * (64 * 16 / tim.getBitPerPixel());
-        data.push_back(TexCoord(face.uv1.u + offset, face.uv1.v, tim.getSize()));
-        data.push_back(TexCoord(face.uv2.u + offset, face.uv2.v, tim.getSize()));
-        data.push_back(TexCoord(face.uv3.u + offset, face.uv3.v, tim.getSize()));
+        MeshData data;
+        std::map<MaterialMode, std::vector<Face>> faceMap;
+
+        for (const Face& face : mesh.faces)
+        {
+            MaterialMode mode(face);
+            faceMap[mode].push_back(face);
+        }
+
+        for (auto& entry : faceMap)
+        {
+            auto primitive = buildPrimitiveData(mesh, entry.first, entry.second);
+            if (merge)
+            {
+                appendPrimitive(merged.try_emplace(entry.first, entry.first).first->second, primitive);
+                continue;
+            }
+
+            finishPrimitive(primitive);
+            data.primitives.push_back(std::move(primitive));
+        }
+
+        if (!merge) meshes.push_back(std::move(data));
     }
 
-    return buildAccessor(data, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, TINYGLTF_TARGET_ARRAY_BUFFER);
+    if (merge && !merged.empty())
+    {
+        MeshData data;
+        for (auto& [mode, primitive] : merged)
+        {
+            finishPrimitive(primitive);
+            data.primitives.push_back(std::move(primitive));
+        }
+
+        meshes.push_back(std::move(data));
+    }
+
+    return meshes;
 }
 
-template<typename T>
-std::size_t GLTFExporter::buildAccessor(std::vector<T> data, int componentType, int type, int target, bool normalized)
+std::size_t GLTFExporter::buildPrimitiveVertex(const PrimitiveData& data)
 {
-    tinygltf::Buffer buffer;
-    T min = data[0];
-    T max = data[0];
+    if (!options.quantize) return buildAccessor<FVector>(data.positions, TINYGLTF_TARGET_ARRAY_BUFFER);
 
-    for (T& val : data)
+    // TMD vertices are plain int16 without fractional bits, so they convert back without loss or scaling
+    std::vector<ShortVector> positions;
+    positions.reserve(data.positions.size());
+    for (auto& pos : data.positions)
+        positions.push_back({ static_cast<int16_t>(pos.x), static_cast<int16_t>(pos.y), static_cast<int16_t>(pos.z) });
+
+    return buildAccessor<ShortVector>(positions, TINYGLTF_TARGET_ARRAY_BUFFER);
+}
+
+std::size_t GLTFExporter::buildPrimitiveNormal(const PrimitiveData& data)
+{
+    if (!options.quantize) return buildAccessor<FVector>(data.normals, TINYGLTF_TARGET_ARRAY_BUFFER);
+
+    // 4.12 fixed point normals fit into normalized int16 with more precision than the source had
+    auto quantize = [](float value)
+    { return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767)); };
+
+    std::vector<ShortVector> normals;
+    normals.reserve(data.normals.size());
+    for (auto& normal : data.normals)
+        normals.push_back({ quantize(normal.x), quantize(normal.y), quantize(normal.z) });
+
+    return buildAccessor<ShortVector>(normals, TINYGLTF_TARGET_ARRAY_BUFFER, true);
+}
+
+std::size_t GLTFExporter::buildPrimitiveColor(const PrimitiveData& data)
+{
+    return buildAccessor<ColorRGB>(data.colors, TINYGLTF_TARGET_ARRAY_BUFFER, true);
+}
+
+std::size_t GLTFExporter::buildPrimitiveTexcoord(const PrimitiveData& data)
+{
+    // texel coordinates within the whole texture, the texture pages are laid out next to each other
+    std::vector<ShortTexCoord> texels;
+    texels.reserve(data.uvs.size());
+
+    auto [offsetX, offsetY] = getTextureOffset();
+    for (std::size_t i = 0; i < data.uvs.size(); i++)
+    {
+        auto offset = (data.texturePages[i] - tim.getPixelX() / 64) * (64 * 16 / tim.getBitPerPixel()) + offsetX;
+        auto u = static_cast<uint16_t>(data.uvs[i].u + offset);
+        auto v = static_cast<uint16_t>(data.uvs[i].v + offsetY);
+        texels.push_back({ u, v });
+    }
+
+    if (!options.quantize)
     {
-        min = myMin(min, val);
-        max = myMax(max, val);
+        std::vector<TexCoord> texcoords;
+        texcoords.reserve(texels.size());
+        for (auto& texel : texels)
+            texcoords.push_back(TexCoord(texel.u, texel.v, getTextureSize()));
 
-        std::copy_n(reinterpret_cast<unsigned char*>(&val), sizeof(val), std::back_inserter(buffer.data));
+        return buildAccessor<TexCoord>(texcoords, TINYGLTF_TARGET_ARRAY_BUFFER);
     }
 
-    auto bufferId = push(model.buffers, buffer);
+    // quantized texcoords stay in texels, the material's texture transform maps them to 0..1
+    auto isByte = [](auto& texel) { return texel.u <= 0xFF && texel.v <= 0xFF; };
+    if (!std::all_of(texels.begin(), texels.end(), isByte))
+        return buildAccessor<ShortTexCoord>(texels, TINYGLTF_TARGET_ARRAY_BUFFER);
+
+    std::vector<ByteTexCoord> bytes;
+    bytes.reserve(texels.size());
+    for (auto& texel : texels)
+        bytes.push_back({ static_cast<uint8_t>(texel.u), static_cast<uint8_t>(texel.v) });
+
+    return buildAccessor<ByteTexCoord>(bytes, TINYGLTF_TARGET_ARRAY_BUFFER);
+}
+
+std::size_t GLTFExporter::buildPrimitiveIndices(const PrimitiveData& data)
+{
+    // 16 bit indices are enough for almost every primitive
+    if (data.positions.size() > std::numeric_limits<uint16_t>::max())
+        return buildAccessor<uint32_t>(data.indices, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+
+    std::vector<uint16_t> indices(data.indices.begin(), data.indices.end());
+    return buildAccessor<uint16_t>(indices, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+}
+
+std::size_t GLTFExporter::buildPrimitiveJoints(const PrimitiveData& data)
+{
+    auto isByte = [](auto joint) { return joint <= std::numeric_limits<uint8_t>::max(); };
+    if (!std::all_of(data.joints.begin(), data.joints.end(), isByte))
+    {
+        std::vector<Vector4<uint16_t>> joints;
+        joints.reserve(data.joints.size());
+        for (auto joint : data.joints)
+            joints.push_back({ joint, 0, 0, 0 });
 
-    tinygltf::BufferView view;
-    view.buffer     = bufferId;
-    view.byteLength = buffer.data.size();
-    if (target == TINYGLTF_TARGET_ARRAY_BUFFER) view.byteStride = sizeof(T);
-    view.byteOffset = 0;
-    view.target     = target;
+        return buildAccessor<Vector4<uint16_t>>(joints, TINYGLTF_TARGET_ARRAY_BUFFER);
+    }
 
-    auto viewId = push(model.bufferViews, view);
+    std::vector<Vector4<uint8_t>> joints;
+    joints.reserve(data.joints.size());
+    for (auto joint : data.joints)
+        joints.push_back({ static_cast<uint8_t>(joint), 0, 0, 0 });
 
-    tinygltf::Accessor accessor;
-    accessor.bufferView    = viewId;
-    accessor.byteOffset    = 0;
-    accessor.componentType = componentType;
-    accessor.count         = data.size();
-    accessor.type          = type;
-    accessor.normalized    = normalized;
-    push_to_vector(accessor.maxValues, max);
-    push_to_vector(accessor.minValues, min);
+    return buildAccessor<Vector4<uint8_t>>(joints, TINYGLTF_TARGET_ARRAY_BUFFER);
+}
 
-    return push(model.accessors, accessor);
+std::size_t GLTFExporter::buildPrimitiveWeights(const PrimitiveData& data)
+{
+    // every vertex is rigidly bound to a single joint
+    std::vector<Vector4<uint8_t>> weights(data.joints.size(), { 0xFF, 0, 0, 0 });
+    return buildAccessor<Vector4<uint8_t>>(weights, TINYGLTF_TARGET_ARRAY_BUFFER, true);
 }
 
-tinygltf::Primitive GLTFExporter::buildPrimitive(const Mesh& mesh, MaterialMode material, std::vector<Face> faces)
+template<typename T> std::size_t GLTFExporter::buildAccessor(std::span<const T> data, int target, bool normalized)
 {
-    tinygltf::Primitive prim;
+    using Traits = AccessorTraits<T>;
 
-    prim.mode     = TINYGLTF_MODE_TRIANGLES;
-    prim.material = buildMaterial(material);
+    auto bytes  = std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size_bytes());
+    auto stride = target == TINYGLTF_TARGET_ARRAY_BUFFER ? sizeof(T) : 0;
 
-    prim.attributes["POSITION"] = buildPrimitiveVertex(mesh, faces);
-    if (material.type != MaterialType::NO_LIGHT) prim.attributes["NORMAL"] = buildPrimitiveNormal(mesh, faces);
-    if (material.type != MaterialType::TEXTURE) prim.attributes["COLOR_0"] = buildPrimitiveColor(faces);
-    if (material.type != MaterialType::COLOR) prim.attributes["TEXCOORD_0"] = buildPrimitiveTexcoord(faces);
+    nlohmann::ordered_json accessor;
+    accessor["bufferView"]    = writer.addBufferView(bytes, target, stride);
+    accessor["componentType"] = Traits::componentType;
+    if (normalized) accessor["normalized"] = true;
+    accessor["count"] = data.size();
+    accessor["type"]  = getAccessorType(Traits::type);
+
+    if (!data.empty())
+    {
+        auto bounds     = computeBounds(data);
+        accessor["max"] = bounds.max;
+        accessor["min"] = bounds.min;
+    }
+
+    return writer.add("accessors", std::move(accessor));
+}
+
+nlohmann::ordered_json GLTFExporter::buildPrimitive(const PrimitiveData& data)
+{
+    nlohmann::ordered_json prim;
+    auto& attributes = prim["attributes"];
+
+    attributes["POSITION"] = buildPrimitiveVertex(data);
+    if (data.material.type != MaterialType::NO_LIGHT) attributes["NORMAL"] = buildPrimitiveNormal(data);
+    if (data.material.type != MaterialType::TEXTURE) attributes["COLOR_0"] = buildPrimitiveColor(data);
+    if (data.material.type != MaterialType::COLOR) attributes["TEXCOORD_0"] = buildPrimitiveTexcoord(data);
+
+    if (!data.joints.empty())
+    {
+        attributes["JOINTS_0"]  = buildPrimitiveJoints(data);
+        attributes["WEIGHTS_0"] = buildPrimitiveWeights(data);
+    }
+
+    if (!data.indices.empty()) prim["indices"] = buildPrimitiveIndices(data);
+    prim["material"] = buildMaterial(data.material);
+    prim["mode"]     = TINYGLTF_MODE_TRIANGLES;
 
     return prim;
 }
 
 void GLTFExporter::buildSkeletonScene()
 {
-    tinygltf::Scene scene;
-    tinygltf::Skin skin;
-    skin.skeleton = 0;
-    auto skinId   = push(model.skins, skin);
+    nlohmann::ordered_json scene;
+    nlohmann::ordered_json skin;
+    skin["skeleton"] = 0;
+    auto skinId      = writer.add("skins", skin);
+
+    // primitives of all nodes merged by material, for the skinned mesh
+    std::map<MaterialMode, PrimitiveData> skinnedPrimitives;
 
     for (auto& mmdNode : mmd.skeleton)
     {
-        tinygltf::Node node;
-        node.name = std::format("node-{}", model.nodes.size());
+        nlohmann::ordered_json node;
+        node["name"] = std::format("node-{}", writer.getDocument()["nodes"].size());
+        auto joint   = static_cast<uint16_t>(writer.getDocument()["nodes"].size());
 
-        if (mmdNode.object != 255)
+        if (mmdNode.object != 255 && options.skinned)
         {
-            auto mesh = mmd.meshes[mmdNode.object];
-            tinygltf::Mesh lMesh;
-            std::map<MaterialMode, std::vector<Face>> faceMap;
-
-            for (const Face& face : mesh.faces)
+            for (auto& primitive : (*meshData)[mmdNode.object].primitives)
             {
-                MaterialMode mode(face);
-                faceMap[mode].push_back(face);
+                auto& target = skinnedPrimitives.try_emplace(primitive.material, primitive.material).first->second;
+                appendPrimitive(target, primitive);
+                target.joints.resize(target.positions.size(), joint);
             }
+        }
+        else if (mmdNode.object != 255)
+        {
+            nlohmann::ordered_json lMesh;
 
-            for (auto& entry : faceMap)
-                lMesh.primitives.push_back(buildPrimitive(mesh, entry.first, entry.second));
+            for (auto& primitive : (*meshData)[mmdNode.object].primitives)
+                lMesh["primitives"].push_back(buildPrimitive(primitive));
 
-            node.mesh = push(model.meshes, lMesh);
+            node["mesh"] = writer.add("meshes", std::move(lMesh));
         }
 
-        auto id = push(model.nodes, node);
+        auto id = writer.add("nodes", std::move(node));
 
         if (mmdNode.parent != 255)
-            model.nodes[mmdNode.parent].children.push_back(id);
+            writer.get("nodes", mmdNode.parent)["children"].push_back(id);
         else
-            scene.nodes.push_back(id);
+            scene["nodes"].push_back(id);
 
-        model.skins[skinId].joints.push_back(id);
+        writer.get("skins", skinId)["joints"].push_back(id);
     }
 
-    model.defaultScene = push(model.scenes, scene);
+    if (!skinnedPrimitives.empty())
+    {
+        // the joints have no transformation of their own, so every vertex already is in its bind pose
+        std::vector<Matrix4> inverseBindMatrices(mmd.skeleton.size());
+        writer.get("skins", skinId)["inverseBindMatrices"] = buildAccessor<Matrix4>(inverseBindMatrices, 0);
+
+        nlohmann::ordered_json lMesh;
+        for (auto& [material, primitive] : skinnedPrimitives)
+            lMesh["primitives"].push_back(buildPrimitive(primitive));
+
+        nlohmann::ordered_json node;
+        node["name"] = "mesh";
+        node["mesh"] = writer.add("meshes", std::move(lMesh));
+        node["skin"] = skinId;
+        scene["nodes"].push_back(writer.add("nodes", std::move(node)));
+    }
+
+    writer.getDocument()["scene"] = writer.add("scenes", std::move(scene));
 }
 
 void GLTFExporter::buildStaticScene()
 {
-    tinygltf::Scene scene;
+    nlohmann::ordered_json scene;
 
-    for (const Mesh& mesh : mmd.meshes)
+    for (const MeshData& mesh : *meshData)
     {
-        tinygltf::Mesh lMesh;
-        std::map<MaterialMode, std::vector<Face>> faceMap;
+        nlohmann::ordered_json lMesh;
 
-        for (const Face& face : mesh.faces)
-        {
-            MaterialMode mode(face);
-            faceMap[mode].push_back(face);
-        }
+        for (auto& primitive : mesh.primitives)
+            lMesh["primitives"].push_back(buildPrimitive(primitive));
 
-        for (auto& entry : faceMap)
-            lMesh.primitives.push_back(buildPrimitive(mesh, entry.first, entry.second));
-
-        auto meshId = push(model.meshes, lMesh);
+        auto meshId = writer.add("meshes", std::move(lMesh));
 
-        tinygltf::Node node;
-        node.mesh = meshId;
+        nlohmann::ordered_json node;
+        node["mesh"] = meshId;
 
-        auto nodeId = push(model.nodes, node);
-        scene.nodes.push_back(nodeId);
+        auto nodeId = writer.add("nodes", std::move(node));
+        scene["nodes"].push_back(nodeId);
     }
 
-    model.defaultScene = push(model.scenes, scene);
+    writer.getDocument()["scene"] = writer.add("scenes", std::move(scene));
 }
 
 void GLTFExporter::buildMeshEntries()
@@ -388,225 +884,404 @@ int32_t GLTFExporter::buildMaterial(MaterialMode mode)
 
     if (existing != materialMapping.end()) return existing->second;
 
-    tinygltf::Material mat;
+    nlohmann::ordered_json mat;
 
-    mat.doubleSided = mode.isDoubleSided;
+    if (mode.isDoubleSided) mat["doubleSided"] = true;
     if (!mode.hasTranslucency)
     {
-        mat.alphaMode   = "MASK";
-        mat.alphaCutoff = 0.1f;
+        mat["alphaMode"]   = "MASK";
+        mat["alphaCutoff"] = 0.1f;
     }
     else
     {
-        tinygltf::Value::Object extras;
-        extras.emplace("blendMode", std::to_string(mode.mixtureRate));
-        mat.extras    = tinygltf::Value(extras);
-        mat.alphaMode = "BLEND";
+        mat["extras"]["blendMode"] = std::to_string(mode.mixtureRate);
+        mat["alphaMode"]           = "BLEND";
     }
 
     if (mode.type == MaterialType::NO_LIGHT)
     {
-        tinygltf::Value unlit;
-        mat.extensions["KHR_materials_unlit"] = unlit;
-        const auto& extUsed                   = model.extensionsUsed;
-        if (std::find(extUsed.begin(), extUsed.end(), "KHR_materials_unlit") == extUsed.end())
-            model.extensionsUsed.push_back("KHR_materials_unlit");
+        mat["extensions"]["KHR_materials_unlit"] = nlohmann::ordered_json::object();
+        writer.useExtension("KHR_materials_unlit");
     }
 
-    mat.pbrMetallicRoughness.baseColorFactor = { 1.0f, 1.0f, 1.0f, 1.0f };
-    mat.pbrMetallicRoughness.metallicFactor  = 0.0f;
-    if (mode.type != MaterialType::COLOR) mat.pbrMetallicRoughness.baseColorTexture.index = 0;
-    auto id               = push(model.materials, mat);
+    auto& pbr              = mat["pbrMetallicRoughness"];
+    pbr["baseColorFactor"] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    pbr["metallicFactor"]  = 0.0f;
+    if (mode.type != MaterialType::COLOR)
+    {
+        auto& texture    = pbr["baseColorTexture"];
+        texture["index"] = 0;
+
+        // same mapping as the float texcoords use, see TexCoord
+        if (options.quantize)
+        {
+            auto [width, height] = getTextureSize();
+            auto& transform      = texture["extensions"]["KHR_texture_transform"];
+            transform["offset"]  = { 0.0001f, 0.0001f };
+            transform["scale"]   = { 1.0f / width, 1.0f / height };
+            writer.useExtension("KHR_texture_transform", true);
+        }
+    }
+
+    auto id               = static_cast<int32_t>(writer.add("materials", std::move(mat)));
     materialMapping[mode] = id;
     return id;
 }
 
+void gatherChannel(const AnimTrack& x,
+                   const AnimTrack& y,
+                   const AnimTrack& z,
+                   std::vector<float>& times,
+                   std::vector<FVector>& values)
+{
+    times.reserve(x.size());
+    values.reserve(x.size());
+
+    float time = -1;
+    for (std::size_t i = 0; i < x.size(); i++)
+    {
+        if (time >= x.times[i]) continue;
+
+        times.push_back(x.times[i]);
+        values.push_back({ x.values[i], y.values[i], z.values[i] });
+        time = x.times[i];
+    }
+}
+
+// converts XYZ Euler angles in degrees to quaternions, all at once so the sine and cosine calculations get vectorized
+static std::vector<Quaternion> toQuaternions(std::span<const FVector> angles)
+{
+    constexpr float HALF_RADIANS_PER_DEGREE = std::numbers::pi_v<float> / 360.0f;
+
+    // half angles of all x components, followed by those of all y and z components
+    auto count = angles.size();
+    std::vector<float> halfAngles(count * 3);
+    std::vector<float> sines(count * 3);
+    std::vector<float> cosines(count * 3);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        halfAngles[i]             = angles[i].x * HALF_RADIANS_PER_DEGREE;
+        halfAngles[count + i]     = angles[i].y * HALF_RADIANS_PER_DEGREE;
+        halfAngles[count * 2 + i] = angles[i].z * HALF_RADIANS_PER_DEGREE;
+    }
+
+    computeSinCos(halfAngles, sines, cosines);
+
+    std::vector<Quaternion> result(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        float c1 = cosines[i];
+        float s1 = sines[i];
+        float c2 = cosines[count + i];
+        float s2 = sines[count + i];
+        float c3 = cosines[count * 2 + i];
+        float s3 = sines[count * 2 + i];
+
+        result[i].w = c1 * c2 * c3 - s1 * s2 * s3;
+        result[i].x = s1 * c2 * c3 + c1 * s2 * s3;
+        result[i].y = -s1 * c2 * s3 + c1 * s2 * c3;
+        result[i].z = c1 * c2 * s3 + s1 * s2 * c3;
+    }
+
+    return result;
+}
+
+// reduces a linearly interpolated channel to the keys needed to reproduce it within the tolerance, returns false if
+// the whole channel matches the rest value and can be dropped
+template<typename T>
+static bool reduceChannel(std::vector<float>& times, std::vector<T>& values, const T& rest, float tolerance)
+{
+    constexpr auto count = AccessorTraits<T>::count;
+    static_assert(sizeof(T) == count * sizeof(float));
+
+    std::span<const float> flat(reinterpret_cast<const float*>(values.data()), values.size() * count);
+    std::span<const float> restValue(reinterpret_cast<const float*>(&rest), count);
+    if (matchesValue(flat, restValue, tolerance)) return false;
+
+    auto kept = reduceKeyframes(times, flat, count, tolerance);
+    for (std::size_t i = 0; i < kept.size(); i++)
+    {
+        times[i]  = times[kept[i]];
+        values[i] = values[kept[i]];
+    }
+
+    times.resize(kept.size());
+    values.resize(kept.size());
+    return true;
+}
+
 void GLTFExporter::buildAnimations()
 {
+    // all axes get a key on every keyframe, so most channels share their timeline and can use the same input accessor
+    std::map<std::vector<float>, std::size_t> timeAccessors;
+    auto buildTimeAccessor = [&](const std::vector<float>& times)
+    {
+        auto it = timeAccessors.find(times);
+        if (it == timeAccessors.end()) it = timeAccessors.emplace(times, buildAccessor<float>(times, 0)).first;
+        return it->second;
+    };
+
     int i = 0;
     for (auto& raw : mmd.anims.anims)
     {
         Animation data(raw);
-        tinygltf::Animation anim;
-        anim.name = std::format("anim-{}", raw.id);
+        nlohmann::ordered_json anim;
+        anim["name"] = std::format("anim-{}", raw.id);
+
+        auto addChannel = [&](int node, const std::string& path, std::size_t input, std::size_t output)
+        {
+            nlohmann::ordered_json sampler;
+            sampler["input"]         = input;
+            sampler["interpolation"] = "LINEAR";
+            sampler["output"]        = output;
+
+            nlohmann::ordered_json channel;
+            channel["sampler"]        = anim["samplers"].size();
+            channel["target"]["node"] = node;
+            channel["target"]["path"] = path;
+
+            anim["samplers"].push_back(std::move(sampler));
+            anim["channels"].push_back(std::move(channel));
+        };
 
         int nodeId = 0;
 
-        for (auto a : data.getData())
+        for (auto& node : data.getData())
         {
             std::vector<float> posTime;
             std::vector<FVector> pos;
             std::vector<float> rotTime;
-            std::vector<Quaternion> rot;
+            std::vector<FVector> angles;
             std::vector<float> scaleTime;
             std::vector<FVector> scale;
 
-            float time = -1;
-            for (int i = 0; i < a.data[Axis::POS_X].size(); i++)
-            {
-                auto posX = a.data[Axis::POS_X][i];
-                auto posY = a.data[Axis::POS_Y][i];
-                auto posZ = a.data[Axis::POS_Z][i];
-
-                if (time >= posX.first) continue;
-
-                posTime.push_back(posX.first);
-                pos.emplace_back(posX.second, posY.second, posZ.second);
-                time = posX.first;
-            }
-
-            time = -1;
-            for (int i = 0; i < a.data[Axis::ROT_X].size(); i++)
-            {
-                auto rotX = a.data[Axis::ROT_X][i];
-                auto rotY = a.data[Axis::ROT_Y][i];
-                auto rotZ = a.data[Axis::ROT_Z][i];
+            gatherChannel(node[Axis::POS_X], node[Axis::POS_Y], node[Axis::POS_Z], posTime, pos);
+            gatherChannel(node[Axis::ROT_X], node[Axis::ROT_Y], node[Axis::ROT_Z], rotTime, angles);
+            gatherChannel(node[Axis::SCALE_X], node[Axis::SCALE_Y], node[Axis::SCALE_Z], scaleTime, scale);
 
-                if (time >= rotX.first) continue;
+            auto rot = toQuaternions(angles);
 
-                rotTime.push_back(rotX.first);
-                rot.emplace_back(FVector{ rotX.second, rotY.second, rotZ.second });
-                time = rotX.first;
-            }
+            bool hasTranslation = true;
+            bool hasRotation    = true;
+            bool hasScale       = true;
 
-            time = -1;
-            for (int i = 0; i < a.data[Axis::SCALE_X].size(); i++)
+            // nodes have no transformation of their own, so channels matching the identity can be dropped
+            if (options.optimizeAnimations)
             {
-                auto scaleX = a.data[Axis::SCALE_X][i];
-                auto scaleY = a.data[Axis::SCALE_Y][i];
-                auto scaleZ = a.data[Axis::SCALE_Z][i];
-
-                if (time >= scaleX.first) continue;
-
-                scaleTime.push_back(scaleX.first);
-                scale.emplace_back(scaleX.second, scaleY.second, scaleZ.second);
-                time = scaleX.first;
+                auto tolerance = options.animationTolerance;
+                hasTranslation = reduceChannel(posTime, pos, FVector{ 0.0f, 0.0f, 0.0f }, tolerance);
+                hasRotation    = reduceChannel(rotTime, rot, Quaternion(0.0f, 0.0f, 0.0f, 1.0f), tolerance);
+                hasScale       = reduceChannel(scaleTime, scale, FVector{ 1.0f, 1.0f, 1.0f }, tolerance);
             }
 
-            tinygltf::AnimationChannel posChannel;
-            tinygltf::AnimationChannel rotChannel;
-            tinygltf::AnimationChannel scaleChannel;
-            tinygltf::AnimationSampler posSampler;
-            tinygltf::AnimationSampler rotSampler;
-            tinygltf::AnimationSampler scaleSampler;
-
-            posSampler.input         = buildAccessor(posTime, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_SCALAR, 0);
-            posSampler.interpolation = "LINEAR";
-            posSampler.output        = buildAccessor(pos, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 0);
-
-            rotSampler.input         = buildAccessor(rotTime, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_SCALAR, 0);
-            rotSampler.interpolation = "LINEAR";
-            rotSampler.output        = buildAccessor(rot, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4, 0);
-
-            scaleSampler.input = buildAccessor(scaleTime, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_SCALAR, 0);
-            scaleSampler.interpolation = "LINEAR";
-            scaleSampler.output        = buildAccessor(scale, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 0);
-
-            posChannel.target_node   = nodeId;
-            posChannel.target_path   = "translation";
-            posChannel.sampler       = push(anim.samplers, posSampler);
-            rotChannel.target_node   = nodeId;
-            rotChannel.target_path   = "rotation";
-            rotChannel.sampler       = push(anim.samplers, rotSampler);
-            scaleChannel.target_node = nodeId;
-            scaleChannel.target_path = "scale";
-            scaleChannel.sampler     = push(anim.samplers, scaleSampler);
-
-            push(anim.channels, posChannel);
-            push(anim.channels, rotChannel);
-            push(anim.channels, scaleChannel);
+            if (hasTranslation)
+                addChannel(nodeId, "translation", buildTimeAccessor(posTime), buildAccessor<FVector>(pos, 0));
+            if (hasRotation)
+                addChannel(nodeId, "rotation", buildTimeAccessor(rotTime), buildAccessor<Quaternion>(rot, 0));
+            if (hasScale)
+                addChannel(nodeId, "scale", buildTimeAccessor(scaleTime), buildAccessor<FVector>(scale, 0));
             nodeId++;
         }
 
-        tinygltf::Value::Object extras;
-        tinygltf::Value::Array soundArray;
-        tinygltf::Value::Array textureArray;
+        // an animation needs at least one channel, a static one gets a constant channel spanning its duration
+        if (!anim.contains("channels") && !data.getData().empty())
+        {
+            auto& keys = data.getData().front()[Axis::POS_X].times;
+            std::vector<float> times{ keys.front(), keys.back() };
+            std::vector<FVector> rest(times.size(), FVector{ 0.0f, 0.0f, 0.0f });
+            addChannel(0, "translation", buildTimeAccessor(times), buildAccessor<FVector>(rest, 0));
+        }
+
+        nlohmann::ordered_json extras = nlohmann::ordered_json::object();
+        nlohmann::ordered_json soundArray;
+        nlohmann::ordered_json textureArray;
 
         for (auto s : data.sound)
         {
-            tinygltf::Value::Object sound;
-            sound.emplace("time", s.time);
-            sound.emplace("vabId", s.vabId);
-            sound.emplace("soundId", s.soundId);
-            soundArray.emplace_back(sound);
+            nlohmann::ordered_json sound;
+            sound["time"]    = s.time;
+            sound["vabId"]   = s.vabId;
+            sound["soundId"] = s.soundId;
+            soundArray.push_back(std::move(sound));
         }
 
         for (auto t : data.texture)
         {
-            tinygltf::Value::Object texture;
-            texture.emplace("time", t.time);
-            texture.emplace("srxX", t.srcX);
-            texture.emplace("srcY", t.srcY);
-            texture.emplace("destX", t.destX);
-            texture.emplace("destY", t.destY);
-            texture.emplace("width", t.width);
-            texture.emplace("height", t.height);
-            textureArray.emplace_back(texture);
+            nlohmann::ordered_json texture;
+            texture["time"]   = t.time;
+            texture["srxX"]   = t.srcX;
+            texture["srcY"]   = t.srcY;
+            texture["destX"]  = t.destX;
+            texture["destY"]  = t.destY;
+            texture["width"]  = t.width;
+            texture["height"] = t.height;
+            textureArray.push_back(std::move(texture));
         }
 
         if (data.endlessStart != -1)
         {
-            extras.emplace("endlessStart", std::to_string(data.endlessStart));
-            extras.emplace("endlessEnd", std::to_string(data.endlessEnd));
+            extras["endlessStart"] = std::to_string(data.endlessStart);
+            extras["endlessEnd"]   = std::to_string(data.endlessEnd);
         }
-        if (!data.sound.empty()) extras.emplace("sounds", soundArray);
-        if (!data.texture.empty()) extras.emplace("textures", textureArray);
-        if (!extras.empty()) anim.extras = tinygltf::Value(extras);
-        push(model.animations, anim);
+        if (!data.sound.empty()) extras["sounds"] = std::move(soundArray);
+        if (!data.texture.empty()) extras["textures"] = std::move(textureArray);
+        if (!extras.empty()) anim["extras"] = std::move(extras);
+        writer.add("animations", std::move(anim));
     }
 }
 
+std::pair<uint32_t, uint32_t> GLTFExporter::getTextureSize() const
+{
+    if (options.atlas && options.atlasSlot) return options.atlas->getSize();
+    return tim.getSize();
+}
+
+std::pair<uint32_t, uint32_t> GLTFExporter::getTextureOffset() const
+{
+    if (options.atlas && options.atlasSlot) return options.atlas->getOffset(*options.atlasSlot);
+    return { 0, 0 };
+}
+
 void GLTFExporter::buildTexture()
 {
     CLUTMap map;
     map.applyModel(mmd);
 
-    tinygltf::Image image;
-
-    image.mimeType   = "image/png";
-    image.bits       = 8;
-    image.component  = 4;
-    image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    PendingImage pending;
     if (forcedPalette)
-        image.image = tim.getRawImage(*forcedPalette);
+        pending.rgba = tim.getRawImage(*forcedPalette);
     else
-        image.image = tim.getRawImage(map);
-    image.width  = tim.getSize().first;
-    image.height = tim.getSize().second;
-    image.name   = "texture";
+        pending.rgba = tim.getRawImage(map);
+    pending.width  = tim.getSize().first;
+    pending.height = tim.getSize().second;
+
+    nlohmann::ordered_json image;
+    image["name"] = "texture";
+
+    nlohmann::ordered_json sampler;
+    sampler["magFilter"] = TINYGLTF_TEXTURE_FILTER_NEAREST;
+    sampler["minFilter"] = TINYGLTF_TEXTURE_FILTER_NEAREST;
 
-    tinygltf::Sampler sampler;
-    sampler.magFilter = TINYGLTF_TEXTURE_FILTER_NEAREST;
-    sampler.minFilter = TINYGLTF_TEXTURE_FILTER_NEAREST;
+    pending.index = writer.add("images", std::move(image));
 
-    tinygltf::Texture tex;
-    tex.source  = push(model.images, image);
-    tex.sampler = push(model.samplers, sampler);
+    nlohmann::ordered_json tex;
+    tex["sampler"] = writer.add("samplers", std::move(sampler));
+    tex["source"]  = pending.index;
 
-    push(model.textures, tex);
+    // lets runtimes find the model's part of the shared atlas without looking at the texcoords
+    if (options.atlas && options.atlasSlot)
+    {
+        auto [offsetX, offsetY] = getTextureOffset();
+        auto [width, height]    = getTextureSize();
+        auto& atlas             = tex["extras"]["atlas"];
+        atlas["slot"]           = *options.atlasSlot;
+        atlas["offset"]         = { offsetX, offsetY };
+        atlas["size"]           = { pending.width, pending.height };
+        atlas["atlasSize"]      = { width, height };
+    }
+
+    writer.add("textures", std::move(tex));
+
+    pendingImages.push_back(std::move(pending));
 }
 
 GLTFExporter::GLTFExporter(const Model& mmd,
                            const AbstractTIM& tim,
                            ModelType type,
-                           std::optional<TIMPalette> forcedPalette)
+                           std::optional<TIMPalette> forcedPalette,
+                           std::shared_ptr<const std::vector<MeshData>> meshData,
+                           ExportOptions options)
     : mmd(mmd)
     , tim(tim)
     , forcedPalette(forcedPalette)
+    , meshData(meshData ? meshData : std::make_shared<const std::vector<MeshData>>(buildMeshData(mmd, options)))
+    , options(options)
 {
     buildAssetEntry(type);
+    if (options.quantize) writer.useExtension("KHR_mesh_quantization", true);
     buildMeshEntries();
     buildAnimations();
     buildTexture();
 }
 
+void appendToBuffer(void* context, void* data, int size)
+{
+    auto buffer = static_cast<std::vector<uint8_t>*>(context);
+    auto bytes  = static_cast<uint8_t*>(data);
+    buffer->insert(buffer->end(), bytes, bytes + size);
+}
+
+bool GLTFExporter::encodeImages()
+{
+    for (auto& pending : pendingImages)
+    {
+        auto& image = writer.get("images", pending.index);
+
+        // shared images are referenced by path, save makes the URI relative once the location of the model is known
+        if (options.atlas && options.atlasSlot)
+        {
+            if (!options.atlas->place(*options.atlasSlot, pending.rgba, pending.width, pending.height)) return false;
+
+            image["uri"] = options.atlas->getFilename().generic_string();
+            externalImages.emplace_back(pending.index, options.atlas->getFilename());
+            continue;
+        }
+
+        if (options.format == OutputFormat::SEPARATE && options.textures)
+        {
+            auto path = options.textures->store(pending.rgba, pending.width, pending.height);
+            if (!path) return false;
+
+            image["uri"] = path->generic_string();
+            externalImages.emplace_back(pending.index, *path);
+            continue;
+        }
+
+        std::vector<uint8_t> png;
+        stbi_write_png_to_func(appendToBuffer, &png, pending.width, pending.height, 4, pending.rgba.data(), 0);
+
+        image["bufferView"] = writer.addBufferView(png);
+        image["mimeType"]   = "image/png";
+    }
+
+    pendingImages.clear();
+    return true;
+}
+
 bool GLTFExporter::save(const std::filesystem::path& filename)
 {
-    tinygltf::TinyGLTF gltf;
-    return gltf.WriteGltfSceneToFile(&model,
-                                     filename.string(),
-                                     true,   // embedImages
-                                     true,   // embedBuffers
-                                     true,   // pretty print
-                                     false); // write binary
-}
\ No newline at end of file
+    if (!encodeImages()) return false;
+
+    for (auto& [index, path] : externalImages)
+        writer.get("images", index)["uri"] = path.lexically_relative(filename.parent_path()).generic_string();
+
+    if (options.format == OutputFormat::SEPARATE) return writer.writeSeparate(filename);
+
+    std::ofstream output(filename, std::ios::binary);
+    return write(output);
+}
+
+std::vector<std::filesystem::path> GLTFExporter::getOutputs(const std::filesystem::path& filename) const
+{
+    std::vector<std::filesystem::path> outputs{ filename };
+    if (options.format == OutputFormat::SEPARATE && writer.getBinarySize() > 0)
+        outputs.push_back(filename.parent_path() / (filename.stem().string() + ".bin"));
+
+    for (auto& [index, path] : externalImages)
+        outputs.push_back(path);
+
+    return outputs;
+}
+
+bool GLTFExporter::write(std::ostream& stream)
+{
+    if (!encodeImages()) return false;
+
+    switch (options.format)
+    {
+        case OutputFormat::GLTF: return writer.writeGLTF(stream);
+        case OutputFormat::GLB: return writer.writeGLB(stream);
+        default: return false;
+    }
+}
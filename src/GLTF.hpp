@@ -1,9 +1,16 @@
 #pragma once
+#include "GLTFWriter.hpp"
 #include "Model.hpp"
 #include "TIM.hpp"
 
-#include <tiny_gltf.h>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
 
 struct ColorRGB
 {
@@ -17,6 +24,7 @@ struct ColorRGB
         : r(color.r)
         , g(color.g)
         , b(color.b)
+        , unused(0)
     {
     }
 };
@@ -45,20 +53,167 @@ public:
     }
 };
 
+// vertex data of a single primitive, the texture it gets used with is applied when exporting
+struct PrimitiveData
+{
+    MaterialMode material;
+    std::vector<FVector> positions;
+    std::vector<FVector> normals;
+    std::vector<ColorRGB> colors;
+    std::vector<UVCoord> uvs;
+    std::vector<uint8_t> texturePages;
+    // empty for a triangle soup, otherwise three entries per triangle referencing the vertex data
+    std::vector<uint32_t> indices;
+    // joint every vertex is bound to when merged into a skinned mesh, empty otherwise
+    std::vector<uint16_t> joints;
+
+    PrimitiveData(MaterialMode material)
+        : material(material)
+    {
+    }
+};
+
+// primitives of a single TMD object, bucketed by material
+struct MeshData
+{
+    std::vector<PrimitiveData> primitives;
+};
+
 enum class ModelType {
     DIGIMON,
     DOOR,
 };
 
+enum class OutputFormat {
+    GLTF,     // JSON with embedded base64 buffers and images
+    GLB,      // binary glTF, a single binary chunk holds all buffer data and images
+    SEPARATE, // JSON with an external .bin buffer and PNG images shared between models
+};
+
+std::string to_string(OutputFormat format);
+// file extension including the dot, e.g. ".glb"
+std::string getExtension(OutputFormat format);
+
+/*
+ * Writes images as PNG files named by their content hash, so every image gets written only once no matter how many
+ * models use it. Safe to use from multiple threads.
+ */
+class TextureStore
+{
+private:
+    std::filesystem::path directory;
+
+    std::mutex mutex;
+    std::map<std::string, std::shared_future<bool>> textures;
+
+public:
+    TextureStore(std::filesystem::path directory);
+
+    // returns the path of the PNG holding the given RGBA image, or nothing if it couldn't be written
+    std::optional<std::filesystem::path> store(const std::vector<unsigned char>& rgba, int32_t width, int32_t height);
+};
+
+/*
+ * Collects the textures of many models in one image, laid out as a grid of equally sized slots. The slot of a model is
+ * fixed, so an atlas left by a previous run gets loaded and only the slots of models exported again get replaced.
+ * Safe to use from multiple threads.
+ */
+class TextureAtlas
+{
+private:
+    std::filesystem::path filename;
+    uint32_t slotWidth;
+    uint32_t slotHeight;
+    uint32_t columns;
+    uint32_t rows;
+
+    std::mutex mutex;
+    std::vector<unsigned char> rgba;
+
+public:
+    TextureAtlas(std::filesystem::path filename, std::size_t slotCount, uint32_t slotWidth, uint32_t slotHeight);
+
+    const std::filesystem::path& getFilename() const { return filename; }
+    std::pair<uint32_t, uint32_t> getSize() const { return { columns * slotWidth, rows * slotHeight }; }
+    std::pair<uint32_t, uint32_t> getSlotSize() const { return { slotWidth, slotHeight }; }
+    // position of the slot's top left texel within the atlas
+    std::pair<uint32_t, uint32_t> getOffset(std::size_t slot) const;
+
+    // copies an RGBA image into the slot, returns false if it doesn't fit
+    bool place(std::size_t slot, const std::vector<unsigned char>& rgba, int32_t width, int32_t height);
+    bool save();
+};
+
+struct ExportOptions
+{
+    OutputFormat format = OutputFormat::GLTF;
+    // where OutputFormat::SEPARATE puts images, they get embedded without one
+    std::shared_ptr<TextureStore> textures;
+    // deduplicate vertices and export indexed primitives
+    bool indexed = false;
+    // reorder indexed primitives for vertex cache and vertex fetch locality
+    bool optimizeMeshes = false;
+    // store vertex attributes as integers (KHR_mesh_quantization) instead of floats
+    bool quantize = false;
+    // drop animation keys that linear interpolation reproduces, as well as constant channels matching the rest pose
+    bool optimizeAnimations = false;
+    // maximum deviation of an optimized animation value from the original one, in units of the channel
+    float animationTolerance = 0.001f;
+    // merge the meshes of all nodes into one skinned mesh, with every vertex bound to the node it belonged to
+    bool skinned = false;
+    // merge the primitives of all objects of static models by material, into a single mesh
+    bool mergeStatic = false;
+    // atlas the texture gets placed in instead of getting its own image, at the given slot
+    std::shared_ptr<TextureAtlas> atlas;
+    std::optional<std::size_t> atlasSlot;
+};
+
+// vertex cache efficiency of optimized meshes, as misses of a simulated FIFO cache
+struct VertexCacheStats
+{
+    std::size_t triangles    = 0;
+    std::size_t missesBefore = 0;
+    std::size_t missesAfter  = 0;
+
+    float getACMRBefore() const { return triangles == 0 ? 0.0f : static_cast<float>(missesBefore) / triangles; }
+    float getACMRAfter() const { return triangles == 0 ? 0.0f : static_cast<float>(missesAfter) / triangles; }
+};
+
+// combines the tracks of three axes into the keys of one animation channel as they get exported, only the first key of
+// every time code is used
+void gatherChannel(const AnimTrack& x,
+                   const AnimTrack& y,
+                   const AnimTrack& z,
+                   std::vector<float>& times,
+                   std::vector<FVector>& values);
+
+std::vector<MeshData> buildMeshData(const Model& model,
+                                    const ExportOptions& options = {},
+                                    VertexCacheStats* stats      = nullptr);
+
 class GLTFExporter
 {
 private:
-    tinygltf::Model model;
+    // texture data waiting to be encoded as PNG
+    struct PendingImage
+    {
+        std::size_t index;
+        std::vector<unsigned char> rgba;
+        int32_t width;
+        int32_t height;
+    };
+
+    GLTFWriter writer;
+    std::vector<PendingImage> pendingImages;
+    // image index -> shared PNG referenced by the image
+    std::vector<std::pair<std::size_t, std::filesystem::path>> externalImages;
 
     const Model& mmd;
     const AbstractTIM& tim;
     std::map<MaterialMode, int32_t> materialMapping;
     std::optional<TIMPalette> forcedPalette;
+    std::shared_ptr<const std::vector<MeshData>> meshData;
+    ExportOptions options;
 
 private:
     void buildAssetEntry(ModelType type);
@@ -68,17 +223,38 @@ private:
     void buildAnimations();
     void buildTexture();
 
-    template<typename T> std::size_t buildAccessor(std::vector<T> data, int componentType, int type, int target, bool normalized = false);
+    // component type and type are derived from T
+    template<typename T> std::size_t buildAccessor(std::span<const T> data, int target, bool normalized = false);
 
     int32_t buildMaterial(MaterialMode mode);
-    tinygltf::Primitive buildPrimitive(const Mesh& mesh, MaterialMode material, std::vector<Face> faces);
-    std::size_t buildPrimitiveVertex(const Mesh& mesh, std::vector<Face> faces);
-    std::size_t buildPrimitiveNormal(const Mesh& mesh, std::vector<Face> faces);
-    std::size_t buildPrimitiveColor(std::vector<Face> faces);
-    std::size_t buildPrimitiveTexcoord(std::vector<Face> faces);
+    nlohmann::ordered_json buildPrimitive(const PrimitiveData& data);
+    std::size_t buildPrimitiveVertex(const PrimitiveData& data);
+    std::size_t buildPrimitiveNormal(const PrimitiveData& data);
+    std::size_t buildPrimitiveColor(const PrimitiveData& data);
+    std::size_t buildPrimitiveTexcoord(const PrimitiveData& data);
+    std::size_t buildPrimitiveIndices(const PrimitiveData& data);
+    std::size_t buildPrimitiveJoints(const PrimitiveData& data);
+    std::size_t buildPrimitiveWeights(const PrimitiveData& data);
+
+    // size of the image the texcoords refer to, the atlas if the texture is placed in one
+    std::pair<uint32_t, uint32_t> getTextureSize() const;
+    // texel offset of the model's texture within the image
+    std::pair<uint32_t, uint32_t> getTextureOffset() const;
 
 public:
-    GLTFExporter(const Model& model, const AbstractTIM& tim, ModelType type = ModelType::DIGIMON, std::optional<TIMPalette> forcedPalette = {});
+    // meshData can be passed in when it was already built for the model, e.g. when the model is exported repeatedly
+    GLTFExporter(const Model& model,
+                 const AbstractTIM& tim,
+                 ModelType type                                        = ModelType::DIGIMON,
+                 std::optional<TIMPalette> forcedPalette               = {},
+                 std::shared_ptr<const std::vector<MeshData>> meshData = nullptr,
+                 ExportOptions options                                 = {});
 
+    // encodes the textures as PNG, or stores them in the TextureStore, done by save/write if not called before
+    bool encodeImages();
     bool save(const std::filesystem::path& filename);
+    // every file save(filename) writes or references, including shared textures
+    std::vector<std::filesystem::path> getOutputs(const std::filesystem::path& filename) const;
+    // OutputFormat::SEPARATE needs to write multiple files and can't be written to a stream
+    bool write(std::ostream& stream);
 };
\ No newline at end of file
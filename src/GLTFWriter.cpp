@@ -0,0 +1,232 @@
+#include "GLTFWriter.hpp"
+
+#include "utils/OrderedLog.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+constexpr uint32_t GLB_MAGIC      = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_VERSION    = 2;
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+constexpr uint32_t GLB_CHUNK_BIN  = 0x004E4942; // "BIN\0"
+constexpr auto DATA_URI_PREFIX    = "data:application/octet-stream;base64,";
+// binary data gets copied in chunks of this size, a multiple of 3 so every chunk encodes to base64 without padding
+constexpr std::size_t COPY_CHUNK_SIZE = 3 * 16 * 1024;
+
+static std::size_t alignTo4(std::size_t value) { return (value + 3) & ~std::size_t(3); }
+
+static void writeUInt32(std::ostream& stream, uint32_t value)
+{
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static std::string encodeBase64(std::span<const uint8_t> data)
+{
+    constexpr auto ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string result;
+    result.reserve((data.size() + 2) / 3 * 4);
+
+    for (std::size_t i = 0; i < data.size(); i += 3)
+    {
+        uint32_t value = data[i] << 16;
+        if (i + 1 < data.size()) value |= data[i + 1] << 8;
+        if (i + 2 < data.size()) value |= data[i + 2];
+
+        result.push_back(ALPHABET[(value >> 18) & 0x3F]);
+        result.push_back(ALPHABET[(value >> 12) & 0x3F]);
+        result.push_back(i + 1 < data.size() ? ALPHABET[(value >> 6) & 0x3F] : '=');
+        result.push_back(i + 2 < data.size() ? ALPHABET[value & 0x3F] : '=');
+    }
+
+    return result;
+}
+
+GLTFWriter::GLTFWriter()
+    : spool(nullptr, std::fclose)
+{
+}
+
+std::size_t GLTFWriter::add(const std::string& type, nlohmann::ordered_json object)
+{
+    auto& array = document[type];
+    array.push_back(std::move(object));
+    return array.size() - 1;
+}
+
+void GLTFWriter::useExtension(const std::string& name, bool required)
+{
+    auto& used = document["extensionsUsed"];
+    if (std::find(used.begin(), used.end(), name) == used.end()) used.push_back(name);
+    if (!required) return;
+
+    auto& requiredExtensions = document["extensionsRequired"];
+    if (std::find(requiredExtensions.begin(), requiredExtensions.end(), name) == requiredExtensions.end())
+        requiredExtensions.push_back(name);
+}
+
+void GLTFWriter::appendBinary(std::span<const uint8_t> data)
+{
+    if (!spool && !spoolFailed && binarySize + data.size() > SPOOL_THRESHOLD && !startSpool())
+    {
+        spoolFailed = true;
+        taskLog() << "Failed to create temporary file for glTF buffer data, keeping it in memory." << std::endl;
+    }
+
+    if (!spool)
+        buffer.insert(buffer.end(), data.begin(), data.end());
+    else if (std::fwrite(data.data(), 1, data.size(), spool.get()) != data.size())
+        throw std::runtime_error("Failed to write glTF buffer data to temporary file.");
+
+    binarySize += data.size();
+}
+
+bool GLTFWriter::startSpool()
+{
+    spool.reset(std::tmpfile());
+    if (!spool) return false;
+
+    if (std::fwrite(buffer.data(), 1, buffer.size(), spool.get()) != buffer.size())
+        throw std::runtime_error("Failed to write glTF buffer data to temporary file.");
+
+    buffer = {};
+    return true;
+}
+
+bool GLTFWriter::readBinary(const std::function<void(std::span<const uint8_t>)>& consumer)
+{
+    if (!spool)
+    {
+        for (std::size_t offset = 0; offset < buffer.size(); offset += COPY_CHUNK_SIZE)
+            consumer(std::span(buffer).subspan(offset, std::min(COPY_CHUNK_SIZE, buffer.size() - offset)));
+        return true;
+    }
+
+    std::vector<uint8_t> chunk(COPY_CHUNK_SIZE);
+    std::rewind(spool.get());
+
+    std::size_t remaining = binarySize;
+    while (remaining > 0)
+    {
+        auto size = std::fread(chunk.data(), 1, std::min(remaining, chunk.size()), spool.get());
+        if (size == 0) return false;
+
+        consumer(std::span(chunk).first(size));
+        remaining -= size;
+    }
+
+    std::fseek(spool.get(), 0, SEEK_END);
+    return true;
+}
+
+std::size_t GLTFWriter::addBufferView(std::span<const uint8_t> data, int32_t target, std::size_t byteStride)
+{
+    // buffer views start on a 4 byte boundary, which satisfies the alignment of every component type
+    static constexpr std::array<uint8_t, 3> padding{};
+    appendBinary(std::span(padding).first(alignTo4(binarySize) - binarySize));
+
+    nlohmann::ordered_json view;
+    view["buffer"]     = 0;
+    view["byteOffset"] = binarySize;
+    view["byteLength"] = data.size();
+    if (byteStride != 0) view["byteStride"] = byteStride;
+    if (target != 0) view["target"] = target;
+
+    appendBinary(data);
+    return add("bufferViews", std::move(view));
+}
+
+nlohmann::ordered_json GLTFWriter::getBufferEntry(const std::string& uri) const
+{
+    nlohmann::ordered_json buffer;
+    buffer["byteLength"] = binarySize;
+    if (!uri.empty()) buffer["uri"] = uri;
+    return nlohmann::ordered_json::array({ buffer });
+}
+
+bool GLTFWriter::copyBinary(std::ostream& stream)
+{
+    auto write = [&](std::span<const uint8_t> chunk)
+    { stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size()); };
+    return readBinary(write) && stream.good();
+}
+
+bool GLTFWriter::copyBinaryAsBase64(std::ostream& stream)
+{
+    auto write = [&](std::span<const uint8_t> chunk) { stream << encodeBase64(chunk); };
+    return readBinary(write) && stream.good();
+}
+
+bool GLTFWriter::writeGLTF(std::ostream& stream)
+{
+    if (binarySize == 0)
+    {
+        document.erase("buffers");
+        stream << document.dump(2);
+        return stream.good();
+    }
+
+    // the base64 data gets streamed into the middle of the JSON text
+    document["buffers"] = getBufferEntry(DATA_URI_PREFIX);
+    auto json           = document.dump(2);
+    auto split          = json.find(DATA_URI_PREFIX) + std::char_traits<char>::length(DATA_URI_PREFIX);
+
+    stream.write(json.data(), split);
+    if (!copyBinaryAsBase64(stream)) return false;
+    stream.write(json.data() + split, json.size() - split);
+    return stream.good();
+}
+
+bool GLTFWriter::writeGLB(std::ostream& stream)
+{
+    if (binarySize == 0)
+        document.erase("buffers");
+    else
+        document["buffers"] = getBufferEntry("");
+
+    auto json = document.dump();
+    json.resize(alignTo4(json.size()), ' ');
+
+    auto binaryLength = alignTo4(binarySize);
+    auto totalLength  = 12 + 8 + json.size() + (binarySize == 0 ? 0 : 8 + binaryLength);
+
+    writeUInt32(stream, GLB_MAGIC);
+    writeUInt32(stream, GLB_VERSION);
+    writeUInt32(stream, static_cast<uint32_t>(totalLength));
+
+    writeUInt32(stream, static_cast<uint32_t>(json.size()));
+    writeUInt32(stream, GLB_CHUNK_JSON);
+    stream.write(json.data(), json.size());
+
+    if (binarySize != 0)
+    {
+        writeUInt32(stream, static_cast<uint32_t>(binaryLength));
+        writeUInt32(stream, GLB_CHUNK_BIN);
+        if (!copyBinary(stream)) return false;
+        for (auto i = binarySize; i < binaryLength; i++)
+            stream.put(0);
+    }
+
+    return stream.good();
+}
+
+bool GLTFWriter::writeSeparate(const std::filesystem::path& filename)
+{
+    if (binarySize == 0)
+        document.erase("buffers");
+    else
+    {
+        auto binaryName = filename.stem().string() + ".bin";
+        std::ofstream binary(filename.parent_path() / binaryName, std::ios::binary);
+        if (!copyBinary(binary)) return false;
+
+        document["buffers"] = getBufferEntry(binaryName);
+    }
+
+    std::ofstream output(filename);
+    output << document.dump(2);
+    return output.good();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Assembles a glTF asset. The JSON document and binary data (accessors, images) are kept in memory, until the binary
+ * data outgrows SPOOL_THRESHOLD and gets spooled to an anonymous temporary file instead. Writing the asset streams
+ * the binary data to the output, so a large asset is never held in memory as a whole.
+ */
+class GLTFWriter
+{
+private:
+    nlohmann::ordered_json document;
+    // binary data while it's below the threshold, or if no temporary file could be created
+    std::vector<uint8_t> buffer;
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> spool;
+    bool spoolFailed       = false;
+    std::size_t binarySize = 0;
+
+private:
+    void appendBinary(std::span<const uint8_t> data);
+    // moves the buffered data into a temporary file, returns false if it couldn't be created
+    bool startSpool();
+    // passes the binary data to the consumer in chunks of at most COPY_CHUNK_SIZE bytes
+    bool readBinary(const std::function<void(std::span<const uint8_t>)>& consumer);
+    nlohmann::ordered_json getBufferEntry(const std::string& uri) const;
+    bool copyBinary(std::ostream& stream);
+    bool copyBinaryAsBase64(std::ostream& stream);
+
+public:
+    // amount of binary data kept in memory before it gets spooled to a temporary file
+    static constexpr std::size_t SPOOL_THRESHOLD = 16 * 1024 * 1024;
+
+    GLTFWriter();
+
+    GLTFWriter(const GLTFWriter&)            = delete;
+    GLTFWriter& operator=(const GLTFWriter&) = delete;
+
+    nlohmann::ordered_json& getDocument() { return document; }
+    // appends an object to the top level array of the given name (e.g. "nodes") and returns its index
+    std::size_t add(const std::string& type, nlohmann::ordered_json object);
+    nlohmann::ordered_json& get(const std::string& type, std::size_t index) { return document[type][index]; }
+    void useExtension(const std::string& name, bool required = false);
+    std::size_t getBinarySize() const { return binarySize; }
+
+    // appends data to the binary buffer and returns the index of a buffer view for it, target and stride are omitted
+    // when 0
+    std::size_t addBufferView(std::span<const uint8_t> data, int32_t target = 0, std::size_t byteStride = 0);
+
+    // embeds the binary buffer as base64 data URI
+    bool writeGLTF(std::ostream& stream);
+    bool writeGLB(std::ostream& stream);
+    // writes the binary buffer into a .bin file next to the .gltf
+    bool writeSeparate(const std::filesystem::path& filename);
+};
@@ -1,8 +1,10 @@
 #pragma once
 #include "Model.hpp"
 
+#include <array>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string_view>
 #include <vector>
 #include <filesystem>
@@ -63,7 +65,7 @@ struct DigimonEntry
 {
     std::string filename;
     std::vector<NodeEntry> skeleton;
-    std::vector<uint8_t> texture;
+    std::span<const uint8_t> texture; // view into the ALLTIM data owned by GameData
 };
 
 
@@ -222,5 +224,30 @@ constexpr VersionData VERSION_DATA[] = { SLUS_DATA,      SLPS_11_DATA,   SLPS_10
 // functions
 
 VersionData getVersion(std::filesystem::path parentPath);
-std::vector<DigimonEntry> loadDigimonEntries(std::filesystem::path parentPath);
-std::array<MapEntry, 255> getMapEntries(std::filesystem::path parentPath);
\ No newline at end of file
+
+/*
+ * Game tables of the PSEXE and ALLTIM, read once and shared between all exporters.
+ * Not copyable, as the entries reference data owned by it.
+ */
+class GameData
+{
+private:
+    VersionData version;
+    std::vector<MMDTexture> textureData;
+    std::vector<DigimonEntry> digimonEntries;
+    std::array<MapEntry, 255> mapEntries;
+
+private:
+    void loadDigimonEntries(const std::vector<uint8_t>& psexe);
+    void loadMapEntries(const std::vector<uint8_t>& psexe);
+
+public:
+    GameData(std::filesystem::path parentPath);
+
+    GameData(const GameData&)            = delete;
+    GameData& operator=(const GameData&) = delete;
+
+    const VersionData& getVersion() const { return version; }
+    std::span<const DigimonEntry> getDigimonEntries() const { return digimonEntries; }
+    std::span<const MapEntry> getMapEntries() const { return mapEntries; }
+};
\ No newline at end of file
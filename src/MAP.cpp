@@ -1,6 +1,9 @@
 #include "MAP.hpp"
 
 #include "GLTF.hpp"
+#include "utils/Hash.hpp"
+#include "utils/OrderedLog.hpp"
+#include "utils/ReadFile.hpp"
 
 #include <nlohmann/json.hpp>
 
@@ -8,6 +11,7 @@
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 MapFile::MapFile(const std::filesystem::path path, const MapEntry entry)
     : entry(entry)
@@ -27,6 +31,8 @@ MapFile::MapFile(const std::filesystem::path path, const MapEntry entry)
 MapFile::MapFile(std::vector<uint8_t>& buffer, const MapEntry entry)
     : entry(entry)
 {
+    if (buffer.empty()) return;
+
     init(buffer.data());
 }
 
@@ -403,13 +409,15 @@ void MAPExporter::saveObject(MapObject& obj, TIMPalette& pal, std::filesystem::p
     }
     else
     {
-        std::cout << "Object with invalid image data detected.\n";
+        taskLog() << "Object with invalid image data detected.\n";
         cimg_library::CImg<uint8_t> png(std::max<uint16_t>(obj.width, 1), std::max<uint16_t>(obj.height, 1), 1, 4, 0);
         png.save_png(path.string().c_str());
     }
+
+    outputs.push_back(path);
 }
 
-bool MAPExporter::save(std::filesystem::path outputDir)
+bool MAPExporter::save(std::filesystem::path outputDir, const ExportOptions& options)
 {
     // write JSON
     auto json = map.to_json();
@@ -429,12 +437,18 @@ bool MAPExporter::save(std::filesystem::path outputDir)
         else
             val = "";
     }
+    outputs.clear();
     std::ofstream(outputDir / "map.json") << json.dump(2);
+    outputs.push_back(outputDir / "map.json");
 
     // write background images
     auto images = tfs.getImages(map);
     for (auto i = 0; i < images.size(); i++)
-        images[i].save_png((outputDir / std::format("background_{}.png", i)).string().c_str());
+    {
+        auto path = outputDir / std::format("background_{}.png", i);
+        images[i].save_png(path.string().c_str());
+        outputs.push_back(path);
+    }
 
     // write object images
     std::map<uint32_t, TIMPalette> clutMapping = getCLUTMap();
@@ -466,15 +480,20 @@ bool MAPExporter::save(std::filesystem::path outputDir)
         }
     }
 
-    // export doors
-    for (auto& [id, model] : doors)
+    // export doors, their meshes are shared between all maps, only the texture is map specific
+    for (auto& [id, door] : doors)
     {
-        auto image = map.getImageByTexCoord(model.getTexturePage() * 64, 0);
-        auto pal   = clutMapping[model.getClutY()];
-        pal        = TIMPalette(pal.begin() + model.getClutX(), pal.end());
+        auto& model = *door.model;
+        auto image  = map.getImageByTexCoord(model.getTexturePage() * 64, 0);
+        auto pal    = clutMapping[model.getClutY()];
+        pal         = TIMPalette(pal.begin() + model.getClutX(), pal.end());
+
+        auto path = outputDir / std::format("door_{}{}", id, getExtension(options.format));
+        GLTFExporter exporter(model, **image, ModelType::DOOR, pal, door.meshData, options);
+        exporter.save(path);
 
-        GLTFExporter exporter(model, **image, ModelType::DOOR, pal);
-        exporter.save(outputDir / std::format("door_{}.gltf", id));
+        auto doorOutputs = exporter.getOutputs(path);
+        outputs.insert(outputs.end(), doorOutputs.begin(), doorOutputs.end());
     }
 
     return true;
@@ -515,4 +534,43 @@ std::map<uint32_t, TIMPalette> MAPExporter::getCLUTMap()
     }
 
     return clutMap;
+}
+
+DoorModel DoorCache::get(uint32_t modelId)
+{
+    std::unique_lock lock(mutex);
+
+    auto existing = doors.find(modelId);
+    if (existing != doors.end())
+    {
+        auto future = existing->second;
+        lock.unlock();
+        return future.get();
+    }
+
+    std::promise<DoorModel> promise;
+    doors.emplace(modelId, promise.get_future().share());
+    lock.unlock();
+
+    try
+    {
+        auto path   = dataPath / std::format("DOOR/DOOR{:02}.TMD", modelId);
+        auto buffer = readFileAsVector<uint8_t>(path);
+
+        std::ostringstream log;
+        LogScope scope(log);
+
+        DoorModel door;
+        door.fileHash = Hash().update(buffer).toString();
+        door.model    = std::make_shared<const Model>(path.filename().string(), buffer);
+        door.meshData = std::make_shared<const std::vector<MeshData>>(buildMeshData(*door.model, options));
+        door.log      = log.str();
+        promise.set_value(door);
+        return door;
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        throw;
+    }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include "GLTF.hpp"
 #include "GameData.hpp"
 #include "TIM.hpp"
 #include "utils/ReadBuffer.hpp"
@@ -7,7 +8,12 @@
 
 #include <array>
 #include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <vector>
 
 
@@ -185,33 +191,67 @@ struct TFSFile
     auto getImage(uint32_t paletteId, MapFile& map) -> cimg_library::CImg<uint8_t>;
 };
 
+struct DoorModel
+{
+    std::shared_ptr<const Model> model;
+    std::shared_ptr<const std::vector<MeshData>> meshData;
+    std::string fileHash;
+    // messages logged while parsing the model, to be printed by one of the maps using it
+    std::string log;
+};
+
+/*
+ * Process-wide cache of the DOOR/DOORxx.TMD models, safe to use from multiple threads.
+ * Each model is parsed once, by whichever thread requests it first. Its messages are collected in DoorModel::log
+ * instead of the log of the requesting task, so they don't depend on which task that was.
+ */
+class DoorCache
+{
+private:
+    std::filesystem::path dataPath;
+    ExportOptions options;
+    std::mutex mutex;
+    std::map<uint32_t, std::shared_future<DoorModel>> doors;
+
+public:
+    DoorCache(std::filesystem::path dataPath, ExportOptions options)
+        : dataPath(dataPath)
+        , options(options)
+    {
+    }
+
+    DoorModel get(uint32_t modelId);
+};
+
 class MAPExporter
 {
 private:
     MapFile map;
     TFSFile tfs;
     MapEntry mapEntry;
-    std::map<uint32_t, Model> doors;
-    std::array<MapEntry, 255> mapEntries;
-    std::vector<DigimonEntry> digimonEntries;
+    std::map<uint32_t, DoorModel> doors;
+    std::span<const MapEntry> mapEntries;
+    std::span<const DigimonEntry> digimonEntries;
+    std::vector<std::filesystem::path> outputs;
 
 public:
     MAPExporter(MapFile map,
                 TFSFile tfs,
                 MapEntry mapEntry,
-                std::map<uint32_t, Model> doors,
-                std::array<MapEntry, 255> mapEntries,
-                std::vector<DigimonEntry> digimonEntries)
-        : map(map)
-        , tfs(tfs)
-        , mapEntry(mapEntry)
-        , doors(doors)
-        , mapEntries(mapEntries)
-        , digimonEntries(digimonEntries)
+                std::map<uint32_t, DoorModel> doors,
+                const GameData& gameData)
+        : map(std::move(map))
+        , tfs(std::move(tfs))
+        , mapEntry(std::move(mapEntry))
+        , doors(std::move(doors))
+        , mapEntries(gameData.getMapEntries())
+        , digimonEntries(gameData.getDigimonEntries())
     {
     }
 
-    bool save(std::filesystem::path outputDir);
+    bool save(std::filesystem::path outputDir, const ExportOptions& options = {});
+    // every file written by save, including the shared textures the doors reference
+    const std::vector<std::filesystem::path>& getOutputs() const { return outputs; }
 
 private:
     void saveObject(MapObject& obj, TIMPalette& pal, std::filesystem::path path, bool is4bpp = false);
@@ -0,0 +1,99 @@
+#include "Manifest.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+constexpr auto MANIFEST_NAME = "manifest.json";
+
+void to_json(nlohmann::ordered_json& json, const ManifestEntry& entry)
+{
+    json["version"] = entry.version;
+    json["options"] = entry.options;
+    json["inputs"]  = entry.inputs;
+    json["outputs"] = entry.outputs;
+}
+
+void from_json(const nlohmann::ordered_json& json, ManifestEntry& entry)
+{
+    json.at("version").get_to(entry.version);
+    json.at("options").get_to(entry.options);
+    json.at("inputs").get_to(entry.inputs);
+    json.at("outputs").get_to(entry.outputs);
+}
+
+Manifest::Manifest(std::filesystem::path outputPath, std::string options, bool force)
+    : outputPath(outputPath)
+    , version(PROJECT_VERSION)
+    , options(options)
+    , force(force)
+{
+    auto path = outputPath / MANIFEST_NAME;
+    if (!std::filesystem::is_regular_file(path)) return;
+
+    // a broken manifest just means everything gets exported again
+    auto json = nlohmann::ordered_json::parse(std::ifstream(path), nullptr, false);
+    if (json.is_discarded() || !json.contains("assets")) return;
+
+    try
+    {
+        json["assets"].get_to(entries);
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        entries.clear();
+    }
+}
+
+ManifestEntry Manifest::createEntry() const
+{
+    ManifestEntry entry;
+    entry.version = version;
+    entry.options = options;
+    return entry;
+}
+
+bool Manifest::isUpToDate(const std::string& asset, const ManifestEntry& entry) const
+{
+    if (force) return false;
+
+    std::lock_guard lock(mutex);
+
+    auto existing = entries.find(asset);
+    if (existing == entries.end()) return false;
+
+    auto& recorded = existing->second;
+    if (recorded.version != entry.version || recorded.options != entry.options || recorded.inputs != entry.inputs)
+        return false;
+
+    for (auto& output : recorded.outputs)
+        if (!std::filesystem::exists(outputPath / output)) return false;
+
+    return true;
+}
+
+void Manifest::update(const std::string& asset, ManifestEntry entry)
+{
+    std::lock_guard lock(mutex);
+    entries[asset] = std::move(entry);
+}
+
+void Manifest::remove(const std::string& asset)
+{
+    std::lock_guard lock(mutex);
+    entries.erase(asset);
+}
+
+bool Manifest::save() const
+{
+    std::lock_guard lock(mutex);
+
+    nlohmann::ordered_json json;
+    json["generator"]["name"]    = PROJECT_NAME;
+    json["generator"]["version"] = PROJECT_VERSION;
+    json["assets"]               = entries;
+
+    std::ofstream output(outputPath / MANIFEST_NAME);
+    output << json.dump(2);
+    return output.good();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ManifestEntry
+{
+    // input name -> content hash
+    std::map<std::string, std::string> inputs;
+    // output files, relative to the output folder
+    std::vector<std::string> outputs;
+    std::string version;
+    std::string options;
+
+    bool operator==(const ManifestEntry& other) const = default;
+};
+
+/*
+ * Records which inputs, tool version and options every output asset was created from, so assets whose inputs didn't
+ * change can be skipped on the next run. Safe to use from multiple threads.
+ */
+class Manifest
+{
+private:
+    std::filesystem::path outputPath;
+    std::string version;
+    std::string options;
+    bool force;
+
+    mutable std::mutex mutex;
+    std::map<std::string, ManifestEntry> entries;
+
+public:
+    Manifest(std::filesystem::path outputPath, std::string options, bool force);
+
+    // creates an entry for the current tool version and options
+    ManifestEntry createEntry() const;
+    // whether the asset was already created from the given inputs and all outputs recorded for it still exist, the
+    // outputs of the given entry are ignored since some assets only know them once they're written
+    bool isUpToDate(const std::string& asset, const ManifestEntry& entry) const;
+    void update(const std::string& asset, ManifestEntry entry);
+    void remove(const std::string& asset);
+    bool save() const;
+};
@@ -258,6 +258,13 @@ Model::Model(filepath mesh, std::vector<NodeEntry> nodes)
     loadMesh(mesh);
 }
 
+Model::Model(std::string name, std::vector<uint8_t>& buffer, std::vector<NodeEntry> nodes)
+    : skeleton(nodes)
+    , name(name)
+{
+    loadMesh(buffer, !filepath(name).extension().compare(".MMD"));
+}
+
 void Model::loadMesh(filepath path)
 {
     if (!std::filesystem::is_regular_file(path)) throw std::runtime_error("Expected a file, but got something else.");
@@ -269,10 +276,15 @@ void Model::loadMesh(filepath path)
     buffer.resize(length);
     input.read(reinterpret_cast<char*>(buffer.data()), length);
 
+    loadMesh(buffer, !path.extension().compare(".MMD"));
+}
+
+void Model::loadMesh(std::vector<uint8_t>& buffer, bool isMMD)
+{
     TMD* tmdPtr     = reinterpret_cast<TMD*>(buffer.data());
     uint8_t* mtnPtr = NULL;
 
-    if (!path.extension().compare(".MMD"))
+    if (isMMD)
     {
         MMD* mmd = reinterpret_cast<MMD*>(buffer.data());
 
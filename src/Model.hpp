@@ -272,6 +272,7 @@ class Model
 private:
     void loadTMD(TMD& tmd);
     void loadMesh(filepath path);
+    void loadMesh(std::vector<uint8_t>& buffer, bool isMMD);
     void loadNodes(filepath path);
 
 public:
@@ -286,6 +287,8 @@ public:
     uint32_t getClutY() const;
 
     Model(filepath mesh, std::vector<NodeEntry> nodes = {});
+    // name is the file name of the buffer's origin, its extension determines the format
+    Model(std::string name, std::vector<uint8_t>& buffer, std::vector<NodeEntry> nodes = {});
 
 
 };
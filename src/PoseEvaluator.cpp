@@ -0,0 +1,217 @@
+#include "PoseEvaluator.hpp"
+
+#include "GLTF.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+Matrix4 operator*(const Matrix4& l, const Matrix4& r)
+{
+    Matrix4 result;
+    for (std::size_t row = 0; row < 4; row++)
+        for (std::size_t column = 0; column < 4; column++)
+        {
+            float sum = 0.0f;
+            for (std::size_t i = 0; i < 4; i++)
+                sum += l(row, i) * r(i, column);
+            result(row, column) = sum;
+        }
+
+    return result;
+}
+
+static FVector lerp(const FVector& a, const FVector& b, float t)
+{
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+}
+
+// keys of a channel, reduced to the ones the glTF export keeps
+struct Channel
+{
+    std::vector<float> times;
+    std::vector<FVector> values;
+    // key to start searching at, advanced by sampleChannel
+    std::size_t cursor = 0;
+
+    Channel(const AnimTrack& x, const AnimTrack& y, const AnimTrack& z) { gatherChannel(x, y, z, times, values); }
+};
+
+// value of a linearly interpolated channel at the given time, times have to be queried in ascending order
+static FVector sampleChannel(Channel& channel, float time)
+{
+    auto& times  = channel.times;
+    auto& cursor = channel.cursor;
+    while (cursor + 1 < times.size() && times[cursor + 1] <= time)
+        cursor++;
+
+    if (cursor + 1 >= times.size() || times[cursor] >= time) return channel.values[cursor];
+
+    auto t = (time - times[cursor]) / (times[cursor + 1] - times[cursor]);
+    return lerp(channel.values[cursor], channel.values[cursor + 1], t);
+}
+
+// T * R * S, with the same XYZ Euler angle convention the glTF export uses for its quaternions
+static Matrix4 toMatrix(const NodeTransform& transform)
+{
+    constexpr float HALF_RADIANS_PER_DEGREE = std::numbers::pi_v<float> / 360.0f;
+
+    auto& angles = transform.rotation;
+    float c1     = std::cos(angles.x * HALF_RADIANS_PER_DEGREE);
+    float s1     = std::sin(angles.x * HALF_RADIANS_PER_DEGREE);
+    float c2     = std::cos(angles.y * HALF_RADIANS_PER_DEGREE);
+    float s2     = std::sin(angles.y * HALF_RADIANS_PER_DEGREE);
+    float c3     = std::cos(angles.z * HALF_RADIANS_PER_DEGREE);
+    float s3     = std::sin(angles.z * HALF_RADIANS_PER_DEGREE);
+
+    float w = c1 * c2 * c3 - s1 * s2 * s3;
+    float x = s1 * c2 * c3 + c1 * s2 * s3;
+    float y = -s1 * c2 * s3 + c1 * s2 * c3;
+    float z = c1 * c2 * s3 + s1 * s2 * c3;
+
+    auto& scale = transform.scale;
+    Matrix4 matrix;
+    matrix(0, 0) = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+    matrix(1, 0) = (2.0f * (x * y + z * w)) * scale.x;
+    matrix(2, 0) = (2.0f * (x * z - y * w)) * scale.x;
+    matrix(0, 1) = (2.0f * (x * y - z * w)) * scale.y;
+    matrix(1, 1) = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+    matrix(2, 1) = (2.0f * (y * z + x * w)) * scale.y;
+    matrix(0, 2) = (2.0f * (x * z + y * w)) * scale.z;
+    matrix(1, 2) = (2.0f * (y * z - x * w)) * scale.z;
+    matrix(2, 2) = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+    matrix(0, 3) = transform.translation.x;
+    matrix(1, 3) = transform.translation.y;
+    matrix(2, 3) = transform.translation.z;
+
+    return matrix;
+}
+
+PoseEvaluator::PoseEvaluator(const Model& model)
+    : PoseEvaluator(model.anims, model.skeleton)
+{
+}
+
+PoseEvaluator::PoseEvaluator(const MMDAnimations& animations, std::span<const NodeEntry> skeleton)
+    : animations(animations)
+    , skeleton(skeleton)
+{
+}
+
+const PoseEvaluator::BakedAnimation& PoseEvaluator::getBaked(std::size_t animation)
+{
+    std::lock_guard lock(mutex);
+
+    auto it = cache.find(animation);
+    if (it != cache.end()) return it->second;
+
+    Animation data(animations.anims.at(animation));
+    auto& nodes = data.getData();
+
+    BakedAnimation baked;
+    baked.endlessStart = data.endlessStart;
+    baked.endlessEnd   = data.endlessEnd;
+
+    // every track ends at the same time, the last keyframe of the animation
+    float lastTime = 0.0f;
+    if (!nodes.empty()) lastTime = nodes.front()[Axis::POS_X].times.back();
+    baked.frameCount = static_cast<std::size_t>(std::lround(lastTime * FRAMES_PER_SECOND)) + 1;
+    baked.frames.resize(baked.frameCount * nodes.size());
+
+    for (std::size_t node = 0; node < nodes.size(); node++)
+    {
+        auto& tracks = nodes[node];
+        Channel translation(tracks[Axis::POS_X], tracks[Axis::POS_Y], tracks[Axis::POS_Z]);
+        Channel rotation(tracks[Axis::ROT_X], tracks[Axis::ROT_Y], tracks[Axis::ROT_Z]);
+        Channel scale(tracks[Axis::SCALE_X], tracks[Axis::SCALE_Y], tracks[Axis::SCALE_Z]);
+
+        for (std::size_t frame = 0; frame < baked.frameCount; frame++)
+        {
+            auto time       = frame / FRAMES_PER_SECOND;
+            auto& transform = baked.frames[frame * nodes.size() + node];
+
+            transform.translation = sampleChannel(translation, time);
+            transform.rotation    = sampleChannel(rotation, time);
+            transform.scale       = sampleChannel(scale, time);
+        }
+    }
+
+    return cache.emplace(animation, std::move(baked)).first->second;
+}
+
+std::vector<NodeTransform> PoseEvaluator::sample(std::size_t animation, float time)
+{
+    auto& baked    = getBaked(animation);
+    auto nodeCount = baked.frames.size() / baked.frameCount;
+
+    auto loopLength = baked.endlessEnd - baked.endlessStart;
+    if (baked.endlessStart >= 0 && loopLength > 0 && time > baked.endlessEnd)
+        time = baked.endlessStart + std::fmod(time - baked.endlessStart, loopLength);
+
+    auto position = std::clamp(time * FRAMES_PER_SECOND, 0.0f, static_cast<float>(baked.frameCount - 1));
+    auto frame    = static_cast<std::size_t>(position);
+    auto next     = std::min(frame + 1, baked.frameCount - 1);
+    auto t        = position - frame;
+
+    std::vector<NodeTransform> result(nodeCount);
+    for (std::size_t node = 0; node < nodeCount; node++)
+    {
+        auto& start = baked.frames[frame * nodeCount + node];
+        auto& end   = baked.frames[next * nodeCount + node];
+
+        result[node].translation = lerp(start.translation, end.translation, t);
+        result[node].rotation    = lerp(start.rotation, end.rotation, t);
+        result[node].scale       = lerp(start.scale, end.scale, t);
+    }
+
+    return result;
+}
+
+Pose PoseEvaluator::evaluate(std::size_t animation, float time)
+{
+    auto transforms = sample(animation, time);
+    auto nodeCount  = skeleton.size();
+
+    Pose pose;
+    pose.local.resize(nodeCount);
+    pose.world.resize(nodeCount);
+
+    for (std::size_t node = 0; node < nodeCount && node < transforms.size(); node++)
+        pose.local[node] = toMatrix(transforms[node]);
+
+    // parents don't have to come before their children, so resolve them on demand. A node that is reached again while
+    // resolving its own parents is part of a cycle, which gets broken by treating it as a root.
+    enum class State
+    {
+        UNRESOLVED,
+        RESOLVING,
+        RESOLVED,
+    };
+    std::vector<State> states(nodeCount, State::UNRESOLVED);
+    auto resolve = [&](std::size_t node, auto& self) -> void
+    {
+        if (states[node] != State::UNRESOLVED) return;
+        states[node] = State::RESOLVING;
+
+        auto parent = skeleton[node].parent;
+        if (parent == 255 || parent >= nodeCount || states[parent] == State::RESOLVING)
+            pose.world[node] = pose.local[node];
+        else
+        {
+            self(parent, self);
+            pose.world[node] = pose.world[parent] * pose.local[node];
+        }
+
+        states[node] = State::RESOLVED;
+    };
+
+    for (std::size_t node = 0; node < nodeCount; node++)
+        resolve(node, resolve);
+
+    return pose;
+}
+
+float PoseEvaluator::getDuration(std::size_t animation)
+{
+    return (getBaked(animation).frameCount - 1) / FRAMES_PER_SECOND;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// 4x4 matrix in column-major order, as used by glTF
+struct Matrix4
+{
+    std::array<float, 16> values{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                  0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+    float& operator()(std::size_t row, std::size_t column) { return values[column * 4 + row]; }
+    float operator()(std::size_t row, std::size_t column) const { return values[column * 4 + row]; }
+
+    friend Matrix4 operator*(const Matrix4& l, const Matrix4& r);
+};
+
+// transformation of a node, rotation as XYZ Euler angles in degrees
+struct NodeTransform
+{
+    FVector translation{ 0.0f, 0.0f, 0.0f };
+    FVector rotation{ 0.0f, 0.0f, 0.0f };
+    FVector scale{ 1.0f, 1.0f, 1.0f };
+};
+
+struct Pose
+{
+    // relative to the parent node
+    std::vector<Matrix4> local;
+    // relative to the model's origin
+    std::vector<Matrix4> world;
+};
+
+/*
+ * Samples the animations of a model at arbitrary times, without going through glTF. The first query of an animation
+ * bakes the transformation of every node at every frame, later queries only interpolate between two baked frames.
+ * Animations are linear between frames and keys sharing a time code are reduced to the first one like the glTF export
+ * does, so the result matches the exported translation and scale channels and the Euler angles of the rotation keys.
+ * Safe to use from multiple threads.
+ */
+class PoseEvaluator
+{
+private:
+    struct BakedAnimation
+    {
+        std::size_t frameCount = 0;
+        // frameCount * nodeCount transformations, frame by frame
+        std::vector<NodeTransform> frames;
+        float endlessStart = -1;
+        float endlessEnd   = -1;
+    };
+
+    const MMDAnimations& animations;
+    std::span<const NodeEntry> skeleton;
+    std::mutex mutex;
+    std::map<std::size_t, BakedAnimation> cache;
+
+private:
+    const BakedAnimation& getBaked(std::size_t animation);
+
+public:
+    static constexpr float FRAMES_PER_SECOND = 20.0f;
+
+    PoseEvaluator(const Model& model);
+    PoseEvaluator(const MMDAnimations& animations, std::span<const NodeEntry> skeleton);
+
+    // transformations of every node of the animation at the given time in seconds, endless loops repeat forever and
+    // other animations hold their last frame
+    std::vector<NodeTransform> sample(std::size_t animation, float time);
+    // local and world matrices of every node of the animation at the given time in seconds
+    Pose evaluate(std::size_t animation, float time);
+    // duration of the animation in seconds
+    float getDuration(std::size_t animation);
+};
@@ -1,109 +1,749 @@
 #include "GLTF.hpp"
 #include "GameData.hpp"
 #include "MAP.hpp"
+#include "Manifest.hpp"
 #include "Model.hpp"
 #include "TIM.hpp"
+#include "utils/Hash.hpp"
+#include "utils/JobPool.hpp"
+#include "utils/OrderedLog.hpp"
+#include "utils/Pipeline.hpp"
+#include "utils/ReadFile.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <set>
+#include <span>
+#include <sstream>
+#include <string_view>
 
-void exportMaps(std::filesystem::path dataPath, std::filesystem::path outputPath)
+template<typename T = std::size_t> std::optional<T> parseNumber(std::string_view value)
 {
-    auto entries        = getMapEntries(dataPath);
-    auto digimonEntries = loadDigimonEntries(dataPath);
+    T result;
+    auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+
+    if (error != std::errc() || ptr != value.data() + value.size()) return {};
+    return result;
+}
+
+// case-insensitive, supports * and ?
+bool matchesGlob(std::string_view pattern, std::string_view text)
+{
+    auto equals = [](char a, char b) { return std::toupper((unsigned char)a) == std::toupper((unsigned char)b); };
+
+    std::size_t p        = 0;
+    std::size_t t        = 0;
+    std::size_t starP    = std::string_view::npos;
+    std::size_t starText = 0;
+
+    while (t < text.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || equals(pattern[p], text[t])))
+        {
+            p++;
+            t++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            starP    = p++;
+            starText = t;
+        }
+        else if (starP != std::string_view::npos)
+        {
+            // let the last * consume one more character
+            p = starP + 1;
+            t = ++starText;
+        }
+        else
+            return false;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+        p++;
+
+    return p == pattern.size();
+}
+
+std::string_view getMapName(const MapEntry& entry)
+{
+    return std::string_view(entry.data.name, strnlen(entry.data.name, sizeof(entry.data.name)));
+}
+
+struct Selection
+{
+    // Digimon IDs or file name patterns, empty selects all
+    std::vector<std::string> digimon;
+    // map file name patterns, empty selects all
+    std::vector<std::string> maps;
+    bool skipModels = false;
+    bool skipMaps   = false;
+
+    bool selectsDigimon(std::size_t id, const DigimonEntry& entry) const
+    {
+        if (digimon.empty()) return true;
+
+        for (auto& value : digimon)
+        {
+            auto number = parseNumber(value);
+            if (number ? *number == id : matchesGlob(value, entry.filename)) return true;
+        }
+
+        return false;
+    }
+
+    bool selectsMap(const MapEntry& entry) const
+    {
+        if (maps.empty()) return true;
+
+        for (auto& pattern : maps)
+            if (matchesGlob(pattern, getMapName(entry))) return true;
+
+        return false;
+    }
+};
+
+
+std::string hashMapEntry(const MapEntry& entry)
+{
+    Hash hash;
+    hash.updateValue(entry.data).update(entry.name);
+    if (entry.toilet) hash.updateValue(*entry.toilet);
+    if (entry.doors) hash.updateValue(*entry.doors);
+    return hash.toString();
+}
+
+void exportMaps(const GameData& gameData,
+                std::filesystem::path dataPath,
+                std::filesystem::path outputPath,
+                JobPool& pool,
+                std::size_t maxInFlight,
+                const Selection& selection,
+                const ExportOptions& options,
+                Manifest& manifest)
+{
+    auto entries = gameData.getMapEntries();
+
+    // map.json references other maps and Digimon by name
+    Hash tableHash;
+    for (auto& entry : entries)
+        tableHash.updateValue(entry.data.name);
+    for (auto& digimon : gameData.getDigimonEntries())
+        tableHash.update(digimon.filename).updateValue('\0');
+
+    OrderedLog log;
+    DoorCache doorCache(dataPath, options);
+    // the messages of a door are printed by the first map using it, independent of which map parses it
+    std::set<uint32_t> loggedDoors;
+    // every map holds its decoded images in memory, limit how many of them exist at once
+    std::counting_semaphore<> slots(std::max<std::size_t>(maxInFlight, 1));
 
     for (auto i = 0; i < entries.size(); i++)
     {
         auto& entry = entries[i];
         auto name   = entry.data.name;
         // entries are allowed to be empty, skip them
-        if (name[0] == 0) continue;
+        if (name[0] == 0 || !selection.selectsMap(entry))
+        {
+            log.commit(i, "");
+            continue;
+        }
 
         std::filesystem::path mapPath = dataPath / std::format("MAP/MAP{}/{}.MAP", 1 + (i / 15), name);
         std::filesystem::path tfsPath = dataPath / std::format("MAP/MAP{}/{}.TFS", 1 + (i / 15), name);
 
         // entries might reference files that don't exist in the final game, skip them
-        if (!std::filesystem::exists(mapPath)) continue;
-        if (!std::filesystem::exists(tfsPath)) continue;
-
-        std::filesystem::path outputDir = outputPath / "maps" / name;
-        std::filesystem::create_directories(outputDir);
-        MapFile map(mapPath, entry);
-        TFSFile tfs(tfsPath);
+        if (!std::filesystem::exists(mapPath) || !std::filesystem::exists(tfsPath))
+        {
+            log.commit(i, "");
+            continue;
+        }
 
-        std::map<uint32_t, Model> doors;
+        std::vector<uint32_t> doorLogs;
         if (entry.doors.has_value())
-        {
-            auto& door = entry.doors.value();
-            for (auto i = 0; i < 6; i++)
+            for (auto modelId : entry.doors->modelId)
+                if (modelId != 0xFF && loggedDoors.insert(modelId).second) doorLogs.push_back(modelId);
+
+        slots.acquire();
+        pool.submit(
+            [&, i, mapPath, tfsPath, doorLogs]
             {
-                auto modelId = door.modelId[i];
-                if (modelId == 0xFF || doors.contains(modelId)) continue;
+                struct SlotRelease
+                {
+                    std::counting_semaphore<>& slots;
+                    ~SlotRelease() { slots.release(); }
+                } release{ slots };
 
-                doors.emplace(modelId, dataPath / std::format("DOOR/DOOR{:02}.TMD", modelId));
-            }
-        }
+                TaskLog out(log, i);
+                auto& entry = entries[i];
+                auto name   = entry.data.name;
 
-        MAPExporter exporter(map, tfs, entry, doors, entries, digimonEntries);
+                auto mapData = readFileAsVector<uint8_t>(mapPath);
+                auto tfsData = readFileAsVector<uint8_t>(tfsPath);
 
-        bool success = exporter.save(outputDir);
-        if (success)
-            std::cout << "Written " << name << std::endl;
-        else
-            std::cout << "Failed to write " << name << std::endl;
+                std::map<uint32_t, DoorModel> doors;
+                if (entry.doors.has_value())
+                {
+                    auto& door = entry.doors.value();
+                    for (auto i = 0; i < 6; i++)
+                    {
+                        auto modelId = door.modelId[i];
+                        if (modelId == 0xFF || doors.contains(modelId)) continue;
+
+                        doors.emplace(modelId, doorCache.get(modelId));
+                    }
+                }
+
+                for (auto modelId : doorLogs)
+                    out << doors.at(modelId).log;
+
+                auto asset         = std::format("maps/{}", name);
+                auto manifestEntry = manifest.createEntry();
+
+                auto& inputs     = manifestEntry.inputs;
+                inputs["map"]    = Hash().update(mapData).toString();
+                inputs["tfs"]    = Hash().update(tfsData).toString();
+                inputs["entry"]  = hashMapEntry(entry);
+                inputs["tables"] = tableHash.toString();
+                for (auto& [id, door] : doors)
+                    inputs[std::format("door_{}", id)] = door.fileHash;
+
+                if (manifest.isUpToDate(asset, manifestEntry))
+                {
+                    out << "Skipped " << name << ", unchanged" << std::endl;
+                    return;
+                }
+
+                std::filesystem::path outputDir = outputPath / "maps" / name;
+                std::filesystem::create_directories(outputDir);
+                MapFile map(mapData, entry);
+                TFSFile tfs(tfsData);
+
+                MAPExporter exporter(std::move(map), std::move(tfs), entry, std::move(doors), gameData);
+
+                bool success = exporter.save(outputDir, options);
+                if (success)
+                {
+                    for (auto& output : exporter.getOutputs())
+                        manifestEntry.outputs.push_back(output.lexically_relative(outputPath).generic_string());
+
+                    manifest.update(asset, std::move(manifestEntry));
+                    out << "Written " << name << std::endl;
+                }
+                else
+                {
+                    manifest.remove(asset);
+                    out << "Failed to write " << name << std::endl;
+                }
+            });
     }
+
+    pool.wait();
 }
 
-void exportModels(std::filesystem::path dataPath, std::filesystem::path outputPath)
+struct ModelJob
 {
-    std::vector<DigimonEntry> entries = loadDigimonEntries(dataPath);
+    std::size_t index; // position in the log
+    std::size_t id;
+    const DigimonEntry* entry;
+    std::string asset;
+    std::ostringstream log;
+    ManifestEntry manifestEntry;
+
+    std::vector<uint8_t> fileData;
+    std::unique_ptr<Model> model;
+    std::unique_ptr<AbstractTIM> tim;
+    std::unique_ptr<GLTFExporter> gltf;
+};
+
+struct PipelineSettings
+{
+    static constexpr std::array<std::string_view, 5> STAGES{ "read", "decode", "build", "encode", "write" };
+
+    std::size_t workers = JobPool::defaultThreadCount();
+    std::map<std::string, std::size_t, std::less<>> queueDepths;
+    std::optional<std::size_t> defaultQueueDepth;
+    bool printStats = false;
+
+    std::size_t getQueueDepth(std::string_view stage) const
+    {
+        auto itr = queueDepths.find(stage);
+        if (itr != queueDepths.end()) return itr->second;
+
+        return defaultQueueDepth.value_or(std::max<std::size_t>(workers, 4));
+    }
+
+    // the I/O stages get a single worker each, the CPU heavy stages split the remaining ones, so the pipeline doesn't
+    // use more threads than requested (but at least one per stage)
+    std::size_t getWorkers(std::string_view stage) const
+    {
+        static constexpr std::array<std::string_view, 3> CPU_STAGES{ "build", "encode", "decode" };
+
+        auto itr = std::ranges::find(CPU_STAGES, stage);
+        if (itr == CPU_STAGES.end()) return 1;
+
+        auto cpuWorkers = workers > 2 ? workers - 2 : 1;
+        auto position   = static_cast<std::size_t>(itr - CPU_STAGES.begin());
+        auto count      = cpuWorkers / CPU_STAGES.size() + (position < cpuWorkers % CPU_STAGES.size() ? 1 : 0);
+        return std::max<std::size_t>(count, 1);
+    }
+};
+
+void exportModels(const GameData& gameData,
+                  std::filesystem::path dataPath,
+                  std::filesystem::path outputPath,
+                  const PipelineSettings& settings,
+                  const Selection& selection,
+                  const ExportOptions& options,
+                  Manifest& manifest)
+{
+    auto entries = gameData.getDigimonEntries();
     std::filesystem::create_directories(outputPath / "digimon");
 
     if (entries.size() == 0) std::cout << "No models found, is the path correct?" << std::endl;
 
-    for (auto id = 0; id < entries.size(); id++)
+    OrderedLog log;
+    Pipeline<ModelJob> pipeline;
+
+    pipeline.addStage("read",
+                      settings.getWorkers("read"),
+                      settings.getQueueDepth("read"),
+                      [&](ModelJob& job)
+                      {
+                          LogScope scope(job.log);
+                          auto path = dataPath / std::format("CHDAT/MMD{}/{}.MMD", job.id / 30, job.entry->filename);
+
+                          if (!std::filesystem::exists(path))
+                          {
+                              job.log << "File " << path << " does not exist, skipping." << std::endl;
+                              return false;
+                          }
+
+                          job.fileData = readFileAsVector<uint8_t>(path);
+
+                          auto& entry       = *job.entry;
+                          job.manifestEntry = manifest.createEntry();
+
+                          auto& inputs       = job.manifestEntry.inputs;
+                          inputs["mmd"]      = Hash().update(job.fileData).toString();
+                          inputs["skeleton"] = Hash().updateValues(std::span(entry.skeleton)).toString();
+                          inputs["texture"]  = Hash().update(entry.texture).toString();
+
+                          if (manifest.isUpToDate(job.asset, job.manifestEntry))
+                          {
+                              job.log << "Skipped " << entry.filename << ", unchanged" << std::endl;
+                              return false;
+                          }
+
+                          return true;
+                      });
+    pipeline.addStage("decode",
+                      settings.getWorkers("decode"),
+                      settings.getQueueDepth("decode"),
+                      [&](ModelJob& job)
+                      {
+                          LogScope scope(job.log);
+                          auto name = job.entry->filename + ".MMD";
+                          job.model = std::make_unique<Model>(name, job.fileData, job.entry->skeleton);
+                          job.tim   = std::make_unique<AbstractTIM>(job.entry->texture.data());
+                          job.fileData.clear();
+                          job.fileData.shrink_to_fit();
+                          return true;
+                      });
+    pipeline.addStage("build",
+                      settings.getWorkers("build"),
+                      settings.getQueueDepth("build"),
+                      [&](ModelJob& job)
+                      {
+                          LogScope scope(job.log);
+                          VertexCacheStats stats;
+                          auto meshData = buildMeshData(*job.model, options, &stats);
+
+                          // every Digimon has a fixed slot in the atlas, so models can be exported individually
+                          auto modelOptions = options;
+                          if (options.atlas) modelOptions.atlasSlot = job.id;
+
+                          job.gltf = std::make_unique<GLTFExporter>(
+                              *job.model,
+                              *job.tim,
+                              ModelType::DIGIMON,
+                              std::nullopt,
+                              std::make_shared<const std::vector<MeshData>>(std::move(meshData)),
+                              modelOptions);
+
+                          if (stats.triangles > 0)
+                              job.log << std::format("Optimized {}, ACMR {:.3f} -> {:.3f}",
+                                                     job.entry->filename,
+                                                     stats.getACMRBefore(),
+                                                     stats.getACMRAfter())
+                                      << std::endl;
+                          return true;
+                      });
+    pipeline.addStage("encode",
+                      settings.getWorkers("encode"),
+                      settings.getQueueDepth("encode"),
+                      [&](ModelJob& job)
+                      {
+                          LogScope scope(job.log);
+                          bool success = job.gltf->encodeImages();
+                          job.tim.reset();
+                          job.model.reset();
+
+                          if (!success)
+                          {
+                              job.gltf.reset();
+                              manifest.remove(job.asset);
+                              job.log << "Failed to write " << job.entry->filename << std::endl;
+                          }
+                          return success;
+                      });
+    pipeline.addStage("write",
+                      settings.getWorkers("write"),
+                      settings.getQueueDepth("write"),
+                      [&](ModelJob& job)
+                      {
+                          // streams the buffer data collected while building straight into the output file(s)
+                          auto path    = outputPath / (job.asset + getExtension(options.format));
+                          bool success = job.gltf->save(path);
+                          auto written = job.gltf->getOutputs(path);
+                          job.gltf.reset();
+
+                          if (success)
+                          {
+                              for (auto& output : written)
+                                  job.manifestEntry.outputs.push_back(
+                                      output.lexically_relative(outputPath).generic_string());
+
+                              manifest.update(job.asset, std::move(job.manifestEntry));
+                              job.log << "Written " << job.entry->filename << std::endl;
+                          }
+                          else
+                          {
+                              manifest.remove(job.asset);
+                              job.log << "Failed to write " << job.entry->filename << std::endl;
+                          }
+                          return true;
+                      });
+    pipeline.setFinishFunction([&](ModelJob& job) { log.commit(job.index, job.log.str()); });
+
+    // only selected models get loaded at all
+    std::vector<ModelJob> jobs;
+    for (std::size_t id = 0; id < entries.size(); id++)
+    {
+        if (!selection.selectsDigimon(id, entries[id])) continue;
+
+        auto& job = jobs.emplace_back();
+        job.index = jobs.size() - 1;
+        job.id    = id;
+        job.entry = &entries[id];
+        job.asset = "digimon/" + entries[id].filename;
+    }
+
+    pipeline.run(std::move(jobs));
+
+    if (settings.printStats) printStageStats(std::cout, pipeline.getStats());
+
+    if (options.atlas && !options.atlas->save()) std::cout << "Failed to write the texture atlas." << std::endl;
+}
+
+// one slot per Digimon, big enough for the largest texture
+std::shared_ptr<TextureAtlas> createTextureAtlas(const GameData& gameData, const std::filesystem::path& outputPath)
+{
+    auto entries        = gameData.getDigimonEntries();
+    uint32_t slotWidth  = 1;
+    uint32_t slotHeight = 1;
+
+    for (auto& entry : entries)
+    {
+        if (entry.texture.empty()) continue;
+
+        auto [width, height] = AbstractTIM(entry.texture.data()).getSize();
+        slotWidth            = std::max(slotWidth, width);
+        slotHeight           = std::max(slotHeight, height);
+    }
+
+    auto filename = outputPath / "textures" / "digimon.png";
+    return std::make_shared<TextureAtlas>(filename, entries.size(), slotWidth, slotHeight);
+}
+
+struct Arguments
+{
+    std::filesystem::path dataPath;
+    std::filesystem::path outputPath = "output";
+    Selection selection;
+    std::size_t jobs = JobPool::defaultThreadCount();
+    std::optional<std::size_t> mapsInFlight;
+    PipelineSettings modelPipeline;
+    OutputFormat format = OutputFormat::GLTF;
+    bool indexed        = false;
+    bool optimizeMeshes = false;
+    bool quantize       = false;
+    bool optimizeAnims  = false;
+    float animTolerance = 0.001f;
+    bool skinned        = false;
+    bool mergeStatic    = false;
+    bool textureAtlas   = false;
+    bool force          = false;
+
+    ExportOptions getExportOptions(const std::filesystem::path& outputPath) const
+    {
+        ExportOptions options;
+        options.format             = format;
+        options.indexed            = indexed || optimizeMeshes;
+        options.optimizeMeshes     = optimizeMeshes;
+        options.quantize           = quantize;
+        options.optimizeAnimations = optimizeAnims;
+        options.animationTolerance = animTolerance;
+        options.skinned            = skinned;
+        options.mergeStatic        = mergeStatic;
+        if (format == OutputFormat::SEPARATE)
+            options.textures = std::make_shared<TextureStore>(outputPath / "textures");
+        return options;
+    }
+};
+
+// options that change the exported files, assets exported with different options are not up to date
+std::string describeOutputOptions(const Arguments& arguments)
+{
+    return std::format("format={};indexed={};optimize-meshes={};quantize={};optimize-anims={};skinned={};"
+                       "merge-static={};texture-atlas={}",
+                       to_string(arguments.format),
+                       arguments.indexed,
+                       arguments.optimizeMeshes,
+                       arguments.quantize,
+                       arguments.optimizeAnims ? std::format("{}", arguments.animTolerance) : "false",
+                       arguments.skinned,
+                       arguments.mergeStatic,
+                       arguments.textureAtlas);
+}
+
+void printUsage()
+{
+    std::cout << "Usage: " << std::endl;
+    std::cout << "DW1ModelConverter [options] <pathToExtractedFolder>" << std::endl;
+    std::cout << "Use tools like dumpsxiso to extract the ROM." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --output <dir>         output folder, defaults to 'output'" << std::endl;
+    std::cout << "  --format <type>        output format of models: gltf (default), glb or separate" << std::endl;
+    std::cout << "  --indexed              export indexed meshes with deduplicated vertices" << std::endl;
+    std::cout << "  --optimize-meshes      reorder indexed meshes for vertex cache locality, implies --indexed"
+              << std::endl;
+    std::cout << "  --quantize             store vertex data as integers (KHR_mesh_quantization)" << std::endl;
+    std::cout << "  --optimize-anims       remove redundant animation keys and channels" << std::endl;
+    std::cout << "  --anim-tolerance <x>   maximum error of --optimize-anims, defaults to 0.001, implies it"
+              << std::endl;
+    std::cout << "  --skinned              export Digimon as a single skinned mesh" << std::endl;
+    std::cout << "  --merge-static         merge the objects of static models, like doors, into a single mesh"
+              << std::endl;
+    std::cout << "  --texture-atlas        put the textures of all Digimon into one shared atlas image" << std::endl;
+    std::cout << "  --digimon <list>       comma separated Digimon IDs or file names (wildcards allowed) to export"
+              << std::endl;
+    std::cout << "  --maps <list>          comma separated map file names (wildcards allowed) to export" << std::endl;
+    std::cout << "  --skip-models          don't export any Digimon" << std::endl;
+    std::cout << "  --skip-maps            don't export any maps" << std::endl;
+    std::cout << "  -j <N>                 number of worker threads, defaults to the number of hardware threads"
+              << std::endl;
+    std::cout << "  --maps-in-flight <N>   maximum number of maps converted at once, defaults to the thread count"
+              << std::endl;
+    std::cout << "  --queue-depth [stage=]<N>" << std::endl;
+    std::cout << "                         capacity of the queue in front of a model pipeline stage (read, decode,"
+              << std::endl;
+    std::cout << "                         build, encode, write), applies to all stages if none is given" << std::endl;
+    std::cout << "  --stats                print model pipeline statistics when done" << std::endl;
+    std::cout << "  --force                export all assets, even those that didn't change since the last run"
+              << std::endl;
+}
+
+std::vector<std::string> splitList(std::string_view list)
+{
+    std::vector<std::string> values;
+
+    while (!list.empty())
     {
-        DigimonEntry& entry             = entries[id];
-        std::filesystem::path modelPath = dataPath / std::format("CHDAT/MMD{}/{}.MMD", id / 30, entry.filename);
+        auto separator = list.find(',');
+        auto value     = list.substr(0, separator);
+        if (!value.empty()) values.emplace_back(value);
 
-        if (!std::filesystem::exists(modelPath))
+        if (separator == std::string_view::npos) break;
+        list.remove_prefix(separator + 1);
+    }
+
+    return values;
+}
+
+std::optional<Arguments> parseArguments(int count, char* args[])
+{
+    Arguments arguments;
+
+    for (int i = 1; i < count; i++)
+    {
+        std::string_view arg = args[i];
+
+        // value of an option that requires one, nothing if the option is the last argument
+        auto getValue = [&]() -> std::optional<std::string_view>
         {
-            std::cout << "File " << modelPath << " does not exist, skipping." << std::endl;
-            continue;
+            if (i + 1 < count) return args[++i];
+
+            std::cout << "Missing value for " << arg << std::endl;
+            return {};
+        };
+
+        if (arg.starts_with("-j"))
+        {
+            auto value = arg.size() > 2 ? arg.substr(2) : (i + 1 < count ? args[++i] : "");
+            auto jobs  = parseNumber(value);
+            if (!jobs || *jobs == 0)
+            {
+                std::cout << "Invalid job count: " << value << std::endl;
+                return {};
+            }
+            arguments.jobs = *jobs;
         }
+        else if (arg == "--maps-in-flight")
+        {
+            auto value = i + 1 < count ? args[++i] : "";
+            auto limit = parseNumber(value);
+            if (!limit || *limit == 0)
+            {
+                std::cout << "Invalid map limit: " << value << std::endl;
+                return {};
+            }
+            arguments.mapsInFlight = *limit;
+        }
+        else if (arg == "--queue-depth")
+        {
+            std::string_view value = i + 1 < count ? args[++i] : "";
+            auto separator         = value.find('=');
+            bool hasStage          = separator != std::string_view::npos;
+            auto stage             = hasStage ? value.substr(0, separator) : std::string_view();
+            auto depth             = parseNumber(hasStage ? value.substr(separator + 1) : value);
+            auto& stages           = PipelineSettings::STAGES;
+            if (!depth || *depth == 0 || (hasStage && std::ranges::find(stages, stage) == stages.end()))
+            {
+                std::cout << "Invalid queue depth: " << value << std::endl;
+                return {};
+            }
+
+            if (!hasStage)
+                arguments.modelPipeline.defaultQueueDepth = *depth;
+            else
+                arguments.modelPipeline.queueDepths[std::string(stage)] = *depth;
+        }
+        else if (arg == "--stats")
+            arguments.modelPipeline.printStats = true;
+        else if (arg == "--format")
+        {
+            auto value = getValue();
+            if (!value) return {};
 
-        Model model(modelPath, entry.skeleton);
-        AbstractTIM tim(entry.texture);
-        GLTFExporter gltf(model, tim);
+            if (*value == "gltf")
+                arguments.format = OutputFormat::GLTF;
+            else if (*value == "glb")
+                arguments.format = OutputFormat::GLB;
+            else if (*value == "separate")
+                arguments.format = OutputFormat::SEPARATE;
+            else
+            {
+                std::cout << "Invalid format: " << *value << std::endl;
+                return {};
+            }
+        }
+        else if (arg == "--indexed")
+            arguments.indexed = true;
+        else if (arg == "--optimize-meshes")
+            arguments.optimizeMeshes = true;
+        else if (arg == "--quantize")
+            arguments.quantize = true;
+        else if (arg == "--texture-atlas")
+            arguments.textureAtlas = true;
+        else if (arg == "--merge-static")
+            arguments.mergeStatic = true;
+        else if (arg == "--skinned")
+            arguments.skinned = true;
+        else if (arg == "--optimize-anims")
+            arguments.optimizeAnims = true;
+        else if (arg == "--anim-tolerance")
+        {
+            auto value = getValue();
+            if (!value) return {};
+
+            auto tolerance = parseNumber<float>(*value);
+            if (!tolerance || *tolerance < 0.0f)
+            {
+                std::cout << "Invalid animation tolerance: " << *value << std::endl;
+                return {};
+            }
+
+            arguments.optimizeAnims = true;
+            arguments.animTolerance = *tolerance;
+        }
+        else if (arg == "--force")
+            arguments.force = true;
+        else if (arg == "--output")
+        {
+            auto value = getValue();
+            if (!value) return {};
+
+            arguments.outputPath = *value;
+        }
+        else if (arg == "--digimon")
+        {
+            auto value = getValue();
+            if (!value) return {};
 
-        bool success = gltf.save(outputPath / std::format("digimon/{}.gltf", entry.filename));
-        if (success)
-            std::cout << "Written " << entry.filename << std::endl;
+            auto values = splitList(*value);
+            arguments.selection.digimon.insert(arguments.selection.digimon.end(), values.begin(), values.end());
+        }
+        else if (arg == "--maps")
+        {
+            auto value = getValue();
+            if (!value) return {};
+
+            auto values = splitList(*value);
+            arguments.selection.maps.insert(arguments.selection.maps.end(), values.begin(), values.end());
+        }
+        else if (arg == "--skip-models")
+            arguments.selection.skipModels = true;
+        else if (arg == "--skip-maps")
+            arguments.selection.skipMaps = true;
+        else if (arguments.dataPath.empty())
+            arguments.dataPath = arg;
         else
-            std::cout << "Failed to write " << entry.filename << std::endl;
+        {
+            std::cout << "Unexpected argument: " << arg << std::endl;
+            return {};
+        }
     }
 
-    // TODO support for multiple images (that one arena)
-    // TODO support for images being used by multiple models
+    if (arguments.dataPath.empty()) return {};
+
+    arguments.modelPipeline.workers = arguments.jobs;
+    return arguments;
 }
 
-// TODO command line switches for:
-// - what to export
-// - output folder
 int main(int count, char* args[])
 {
-    const std::filesystem::path output = "output";
-
-    if (count < 2)
+    auto arguments = parseArguments(count, args);
+    if (!arguments)
     {
-        std::cout << "Usage: " << std::endl;
-        std::cout << "DW1ModelConverter <pathToExtractedFolder>" << std::endl;
-        std::cout << "Use tools like dumpsxiso to extract the ROM." << std::endl;
-        return EXIT_SUCCESS;
+        printUsage();
+        return EXIT_FAILURE;
     }
 
-    std::filesystem::path dataPath = args[1];
+    std::filesystem::path dataPath = arguments->dataPath;
+    std::filesystem::path output   = arguments->outputPath;
+    const Selection& selection     = arguments->selection;
 
     if (!std::filesystem::exists(output))
         if (!std::filesystem::create_directories(output))
@@ -112,8 +752,48 @@ int main(int count, char* args[])
             return EXIT_FAILURE;
         }
 
-    exportModels(dataPath, output);
-    exportMaps(dataPath, output);
+    GameData gameData(dataPath);
+    Manifest manifest(output, describeOutputOptions(*arguments), arguments->force);
+
+    // selections that match nothing are most likely typos
+    auto digimon = gameData.getDigimonEntries();
+    for (auto& value : selection.digimon)
+    {
+        Selection single;
+        single.digimon = { value };
+        bool found = false;
+        for (std::size_t id = 0; id < digimon.size() && !found; id++)
+            found = single.selectsDigimon(id, digimon[id]);
+
+        if (!found) std::cout << "No Digimon matches " << value << std::endl;
+    }
+
+    auto maps = gameData.getMapEntries();
+    for (auto& value : selection.maps)
+    {
+        Selection single;
+        single.maps = { value };
+        bool found = false;
+        for (std::size_t i = 0; i < maps.size() && !found; i++)
+            found = !getMapName(maps[i]).empty() && single.selectsMap(maps[i]);
+
+        if (!found) std::cout << "No map matches " << value << std::endl;
+    }
+
+    auto options = arguments->getExportOptions(output);
+    if (arguments->textureAtlas && !selection.skipModels) options.atlas = createTextureAtlas(gameData, output);
+
+    if (!selection.skipModels)
+        exportModels(gameData, dataPath, output, arguments->modelPipeline, selection, options, manifest);
+
+    if (!selection.skipMaps)
+    {
+        JobPool pool(arguments->jobs);
+        auto mapsInFlight = arguments->mapsInFlight.value_or(pool.getThreadCount());
+        exportMaps(gameData, dataPath, output, pool, mapsInFlight, selection, options, manifest);
+    }
+
+    if (!manifest.save()) std::cout << "Failed to write the manifest." << std::endl;
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/*
+ * 64-bit FNV-1a hash, used to fingerprint input data.
+ */
+class Hash
+{
+private:
+    uint64_t state = 0xCBF29CE484222325ull;
+
+public:
+    Hash& update(std::span<const uint8_t> data)
+    {
+        for (auto byte : data)
+        {
+            state ^= byte;
+            state *= 0x100000001B3ull;
+        }
+        return *this;
+    }
+
+    Hash& update(std::string_view data)
+    {
+        return update(std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    Hash& updateValues(std::span<const T> data)
+    {
+        return update(std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size_bytes()));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    Hash& updateValue(const T& value)
+    {
+        return update(std::span(reinterpret_cast<const uint8_t*>(&value), sizeof(T)));
+    }
+
+    uint64_t get() const { return state; }
+    std::string toString() const { return std::format("{:016x}", state); }
+};
@@ -0,0 +1,135 @@
+#include "JobPool.hpp"
+
+#include <algorithm>
+
+// index of the worker the current thread belongs to, -1 for threads outside of any pool
+static thread_local const JobPool* currentPool = nullptr;
+static thread_local std::size_t currentWorker  = -1;
+
+std::size_t JobPool::defaultThreadCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+JobPool::JobPool(std::size_t threadCount)
+{
+    threadCount = std::max<std::size_t>(threadCount, 1);
+
+    for (std::size_t i = 0; i < threadCount; i++)
+        queues.push_back(std::make_unique<WorkQueue>());
+
+    for (std::size_t i = 0; i < threadCount; i++)
+        workers.emplace_back(&JobPool::workerLoop, this, i);
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::unique_lock lock(stateMutex);
+        jobsDone.wait(lock, [this] { return pendingJobs == 0; });
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void JobPool::submit(Job job)
+{
+    std::size_t target;
+
+    {
+        std::lock_guard lock(stateMutex);
+        target = currentPool == this ? currentWorker : nextQueue++ % queues.size();
+        pendingJobs++;
+    }
+
+    {
+        std::lock_guard lock(queues[target]->mutex);
+        queues[target]->jobs.push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard lock(stateMutex);
+        queuedJobs++;
+    }
+    jobAvailable.notify_one();
+}
+
+void JobPool::wait()
+{
+    std::unique_lock lock(stateMutex);
+    jobsDone.wait(lock, [this] { return pendingJobs == 0; });
+
+    if (firstError)
+    {
+        auto error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool JobPool::tryPop(std::size_t id, Job& job)
+{
+    // own queue first, newest job
+    {
+        auto& own = *queues[id];
+        std::lock_guard lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // steal the oldest job of someone else
+    for (std::size_t i = 1; i < queues.size(); i++)
+    {
+        auto& other = *queues[(id + i) % queues.size()];
+        std::lock_guard lock(other.mutex);
+        if (!other.jobs.empty())
+        {
+            job = std::move(other.jobs.front());
+            other.jobs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobPool::workerLoop(std::size_t id)
+{
+    currentPool   = this;
+    currentWorker = id;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(stateMutex);
+            jobAvailable.wait(lock, [this] { return stopping || queuedJobs > 0; });
+            if (queuedJobs == 0) return; // stopping and nothing left to do
+            queuedJobs--;
+        }
+
+        // a job has been reserved for us, it might just not be visible in a queue yet
+        Job job;
+        while (!tryPop(id, job))
+            std::this_thread::yield();
+
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+            std::lock_guard lock(stateMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock(stateMutex);
+            pendingJobs--;
+            if (pendingJobs == 0) jobsDone.notify_all();
+        }
+    }
+}
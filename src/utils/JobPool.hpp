@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing thread pool.
+ *
+ * Every worker owns a deque of jobs. Workers take jobs from the back of their own deque and, once it runs dry, steal
+ * from the front of the other workers' deques. Jobs submitted from outside the pool are distributed round-robin,
+ * jobs submitted from inside a job go to the deque of the submitting worker.
+ */
+class JobPool
+{
+public:
+    using Job = std::function<void()>;
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    std::size_t queuedJobs  = 0;
+    std::size_t pendingJobs = 0;
+    std::size_t nextQueue   = 0;
+    bool stopping           = false;
+    std::exception_ptr firstError;
+
+private:
+    void workerLoop(std::size_t id);
+    bool tryPop(std::size_t id, Job& job);
+
+public:
+    explicit JobPool(std::size_t threadCount = defaultThreadCount());
+    ~JobPool();
+
+    JobPool(const JobPool&)            = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    // queues a job, may be called from within a job
+    void submit(Job job);
+    // blocks until every submitted job has finished, rethrows the first exception thrown by a job
+    void wait();
+
+    std::size_t getThreadCount() const { return workers.size(); }
+
+    static std::size_t defaultThreadCount();
+};
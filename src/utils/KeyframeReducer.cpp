@@ -0,0 +1,61 @@
+#include "KeyframeReducer.hpp"
+
+#include <cmath>
+
+// whether the keys between first and last can be linearly interpolated from those two
+static bool isInterpolatable(std::span<const float> times,
+                             std::span<const float> values,
+                             std::size_t components,
+                             std::size_t first,
+                             std::size_t last,
+                             float tolerance)
+{
+    auto duration = times[last] - times[first];
+
+    for (auto key = first + 1; key < last; key++)
+    {
+        auto t = (times[key] - times[first]) / duration;
+
+        for (std::size_t i = 0; i < components; i++)
+        {
+            auto start = values[first * components + i];
+            auto end   = values[last * components + i];
+            if (std::abs(start + (end - start) * t - values[key * components + i]) > tolerance) return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<std::size_t> reduceKeyframes(std::span<const float> times,
+                                         std::span<const float> values,
+                                         std::size_t components,
+                                         float tolerance)
+{
+    std::vector<std::size_t> kept;
+    if (times.empty()) return kept;
+
+    kept.push_back(0);
+    if (matchesValue(values, values.first(components), tolerance)) return kept;
+
+    // greedily extend the current segment for as long as every key it skips stays within the tolerance
+    std::size_t anchor = 0;
+    for (std::size_t key = 2; key < times.size(); key++)
+    {
+        if (isInterpolatable(times, values, components, anchor, key, tolerance)) continue;
+
+        anchor = key - 1;
+        kept.push_back(anchor);
+    }
+
+    if (times.size() > 1) kept.push_back(times.size() - 1);
+    return kept;
+}
+
+bool matchesValue(std::span<const float> values, std::span<const float> value, float tolerance)
+{
+    for (std::size_t i = 0; i < values.size(); i++)
+        if (std::abs(values[i] - value[i % value.size()]) > tolerance) return false;
+
+    return true;
+}
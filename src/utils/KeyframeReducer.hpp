@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/*
+ * Keyframe reduction for linearly interpolated animation channels. Key values are passed flat, with `components`
+ * floats per key, and compared per component against an absolute tolerance.
+ */
+
+// returns the indices of the keys needed to reconstruct the channel within the tolerance through linear interpolation,
+// always including the first key and, unless the channel is constant, the last one
+std::vector<std::size_t> reduceKeyframes(std::span<const float> times,
+                                         std::span<const float> values,
+                                         std::size_t components,
+                                         float tolerance);
+
+// whether every key of the channel is within the tolerance of the given value
+bool matchesValue(std::span<const float> values, std::span<const float> value, float tolerance);
@@ -0,0 +1,185 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr std::size_t SIMULATED_CACHE_SIZE = 32;
+constexpr float LAST_TRIANGLE_SCORE        = 0.75f;
+constexpr float CACHE_DECAY_POWER          = 1.5f;
+constexpr float VALENCE_BOOST_SCALE        = 2.0f;
+constexpr float VALENCE_BOOST_POWER        = 0.5f;
+
+constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+
+std::size_t countCacheMisses(std::span<const uint32_t> indices, std::size_t vertexCount, std::size_t cacheSize)
+{
+    // a vertex is still cached if less than cacheSize misses happened since it was loaded
+    std::vector<std::size_t> loadedAt(vertexCount, 0);
+    std::size_t misses = 0;
+    std::size_t time   = cacheSize + 1;
+
+    for (auto index : indices)
+    {
+        if (time - loadedAt[index] <= cacheSize) continue;
+
+        loadedAt[index] = time++;
+        misses++;
+    }
+
+    return misses;
+}
+
+static float getVertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+    // vertices without triangles left should never be picked
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 3)
+    {
+        auto scale = 1.0f / (SIMULATED_CACHE_SIZE - 3);
+        score      = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+    }
+    // the vertices of the last triangle get a fixed score, so the next triangle doesn't just continue a strip
+    else if (cachePosition >= 0)
+        score = LAST_TRIANGLE_SCORE;
+
+    // vertices with few triangles left get boosted, so they get finished instead of leaving single triangles behind
+    return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, std::size_t vertexCount)
+{
+    auto triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // triangles using each vertex, as offsets into one shared list
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (auto index : indices)
+        remaining[index]++;
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (std::size_t i = 0; i < vertexCount; i++)
+        offsets[i + 1] = offsets[i] + remaining[i];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); i++)
+        adjacency[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<float> vertexScore(vertexCount);
+    for (std::size_t i = 0; i < vertexCount; i++)
+        vertexScore[i] = getVertexScore(-1, remaining[i]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (std::size_t i = 0; i < triangleCount; i++)
+        triangleScore[i] = vertexScore[indices[i * 3]] + vertexScore[indices[i * 3 + 1]] +
+                           vertexScore[indices[i * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // holds up to 3 more entries than simulated, they get evicted once their scores got updated
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(SIMULATED_CACHE_SIZE + 3);
+    nextCache.reserve(SIMULATED_CACHE_SIZE + 3);
+
+    std::size_t nextUnemitted = 0;
+    uint32_t best             = 0;
+    float bestScore           = triangleScore[0];
+    for (std::size_t i = 1; i < triangleCount; i++)
+    {
+        if (triangleScore[i] <= bestScore) continue;
+        best      = static_cast<uint32_t>(i);
+        bestScore = triangleScore[i];
+    }
+
+    // sets the score of a vertex for its new cache position, -1 if it isn't cached, and updates its triangles
+    auto updateVertex = [&](uint32_t vertex, int32_t position)
+    {
+        auto newScore       = getVertexScore(position, remaining[vertex]);
+        auto delta          = newScore - vertexScore[vertex];
+        vertexScore[vertex] = newScore;
+
+        for (auto j = offsets[vertex]; j < offsets[vertex] + remaining[vertex]; j++)
+            triangleScore[adjacency[j]] += delta;
+    };
+
+    while (true)
+    {
+        emitted[best] = true;
+        nextCache.clear();
+
+        for (std::size_t i = 0; i < 3; i++)
+        {
+            auto vertex = indices[best * 3 + i];
+            output.push_back(vertex);
+
+            // a degenerate triangle uses a vertex more than once, it still takes up a single cache entry
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) nextCache.push_back(vertex);
+
+            // remove the triangle from the vertex's triangle list, once per use
+            auto begin = adjacency.begin() + offsets[vertex];
+            auto end   = begin + remaining[vertex];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            remaining[vertex]--;
+        }
+
+        auto added = nextCache.size();
+        for (auto vertex : cache)
+            if (std::find(nextCache.begin(), nextCache.begin() + added, vertex) == nextCache.begin() + added)
+                nextCache.push_back(vertex);
+
+        std::swap(cache, nextCache);
+
+        // vertices pushed out of the cache lose their cache score, and so do their triangles
+        for (std::size_t i = SIMULATED_CACHE_SIZE; i < cache.size(); i++)
+            updateVertex(cache[i], -1);
+        if (cache.size() > SIMULATED_CACHE_SIZE) cache.resize(SIMULATED_CACHE_SIZE);
+
+        // update scores of everything still cached and pick the best triangle next to it
+        for (std::size_t i = 0; i < cache.size(); i++)
+            updateVertex(cache[i], static_cast<int32_t>(i));
+
+        best      = UNUSED;
+        bestScore = -1.0f;
+        for (auto vertex : cache)
+            for (auto j = offsets[vertex]; j < offsets[vertex] + remaining[vertex]; j++)
+            {
+                auto triangle = adjacency[j];
+                if (triangleScore[triangle] <= bestScore) continue;
+
+                best      = triangle;
+                bestScore = triangleScore[triangle];
+            }
+
+        // nothing connected to the cache is left, continue with the next triangle in the original order
+        if (best == UNUSED)
+        {
+            while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+                nextUnemitted++;
+
+            if (nextUnemitted == triangleCount) break;
+            best = static_cast<uint32_t>(nextUnemitted);
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices, std::size_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    uint32_t next = 0;
+
+    for (auto& index : indices)
+    {
+        if (remap[index] == UNUSED) remap[index] = next++;
+        index = remap[index];
+    }
+
+    return remap;
+}
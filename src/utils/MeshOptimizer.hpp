@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * Index buffer optimizations for triangle lists.
+ *
+ * optimizeVertexCache reorders triangles for post-transform vertex cache locality, using Tom Forsyth's "Linear-Speed
+ * Vertex Cache Optimisation". optimizeVertexFetch then renumbers vertices in the order they're first used, so vertex
+ * fetches walk the vertex buffers mostly linearly.
+ */
+
+// number of vertex cache misses of a FIFO cache of the given size, misses per triangle are the ACMR
+std::size_t countCacheMisses(std::span<const uint32_t> indices, std::size_t vertexCount, std::size_t cacheSize = 16);
+
+void optimizeVertexCache(std::span<uint32_t> indices, std::size_t vertexCount);
+
+// renumbers the indices and returns the new index of every old vertex, unused vertices get dropped and map to -1
+std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices, std::size_t vertexCount);
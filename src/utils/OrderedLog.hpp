@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+/*
+ * Collects the output of concurrently running tasks and prints it in task order.
+ *
+ * The output of task N is held back until every task before it has been committed, so the log looks the same no
+ * matter how many threads are used. Every index has to be committed exactly once, even when it produced no output.
+ */
+class OrderedLog
+{
+private:
+    std::mutex mutex;
+    std::ostream& out;
+    std::map<std::size_t, std::string> pending;
+    std::size_t next = 0;
+
+public:
+    OrderedLog(std::ostream& out = std::cout)
+        : out(out)
+    {
+    }
+
+    void commit(std::size_t index, std::string text)
+    {
+        std::lock_guard lock(mutex);
+        pending.emplace(index, std::move(text));
+
+        for (auto itr = pending.find(next); itr != pending.end(); itr = pending.find(++next))
+        {
+            out << itr->second;
+            pending.erase(itr);
+        }
+
+        out.flush();
+    }
+};
+
+namespace detail
+{
+    inline thread_local std::ostream* currentTaskLog = nullptr;
+}
+
+/*
+ * Redirects taskLog() on the current thread into the given stream while alive.
+ */
+class LogScope
+{
+private:
+    std::ostream* previous;
+
+public:
+    LogScope(std::ostream& stream)
+        : previous(detail::currentTaskLog)
+    {
+        detail::currentTaskLog = &stream;
+    }
+
+    ~LogScope() { detail::currentTaskLog = previous; }
+
+    LogScope(const LogScope&)            = delete;
+    LogScope& operator=(const LogScope&) = delete;
+};
+
+/*
+ * Log of a single task. While alive, taskLog() on the same thread writes into it, on destruction the collected
+ * output gets committed to the OrderedLog.
+ */
+class TaskLog : public std::ostringstream
+{
+private:
+    OrderedLog& log;
+    std::size_t index;
+    LogScope scope;
+
+public:
+    TaskLog(OrderedLog& log, std::size_t index)
+        : log(log)
+        , index(index)
+        , scope(*this)
+    {
+    }
+
+    ~TaskLog() { log.commit(index, str()); }
+};
+
+// stream for messages that belong to the currently running task, std::cout outside of tasks
+inline std::ostream& taskLog() { return detail::currentTaskLog ? *detail::currentTaskLog : std::cout; }
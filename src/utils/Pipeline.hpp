@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Blocking FIFO queue with a fixed capacity.
+ */
+template<typename T> class BoundedQueue
+{
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    std::size_t capacity;
+    std::size_t peakSize = 0;
+    bool closed          = false;
+
+public:
+    BoundedQueue(std::size_t capacity)
+        : capacity(std::max<std::size_t>(capacity, 1))
+    {
+    }
+
+    void push(T item)
+    {
+        std::unique_lock lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        peakSize = std::max(peakSize, items.size());
+        notEmpty.notify_one();
+    }
+
+    // returns nothing once the queue is closed and drained
+    std::optional<T> pop()
+    {
+        std::unique_lock lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return {};
+
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+    std::size_t getCapacity() const { return capacity; }
+    std::size_t getPeakSize() const { return peakSize; }
+};
+
+struct StageStats
+{
+    std::string name;
+    std::size_t workers    = 0;
+    std::size_t queueDepth = 0;
+    std::size_t peakQueue  = 0;
+    std::size_t items      = 0;
+    double busyTime        = 0.0; // seconds spent in the stage function
+    double idleTime        = 0.0; // seconds spent waiting for input
+    double blockedTime     = 0.0; // seconds spent waiting for the next stage to accept output
+};
+
+inline void printStageStats(std::ostream& out, const std::vector<StageStats>& stats)
+{
+    out << std::format("{:<8} {:>7} {:>6} {:>6} {:>7} {:>10} {:>10} {:>10}\n",
+                       "stage",
+                       "workers",
+                       "queue",
+                       "peak",
+                       "items",
+                       "busy [s]",
+                       "idle [s]",
+                       "blocked [s]");
+
+    for (auto& stage : stats)
+        out << std::format("{:<8} {:>7} {:>6} {:>6} {:>7} {:>10.3f} {:>10.3f} {:>10.3f}\n",
+                           stage.name,
+                           stage.workers,
+                           stage.queueDepth,
+                           stage.peakQueue,
+                           stage.items,
+                           stage.busyTime,
+                           stage.idleTime,
+                           stage.blockedTime);
+}
+
+/*
+ * Runs items through a fixed sequence of stages, each served by its own worker threads.
+ *
+ * Stages are connected by bounded queues, the queue in front of a stage limits how many items may wait for it. This
+ * lets I/O bound stages of one item overlap with CPU bound stages of others, while keeping the amount of items in
+ * flight bounded. A stage function returning false finishes the item early, skipping all later stages.
+ */
+template<typename T> class Pipeline
+{
+public:
+    using StageFunction  = std::function<bool(T&)>;
+    using FinishFunction = std::function<void(T&)>;
+
+private:
+    struct Stage
+    {
+        StageStats stats;
+        StageFunction function;
+        std::unique_ptr<BoundedQueue<T>> input;
+        std::mutex statsMutex;
+    };
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    FinishFunction onFinished;
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+
+private:
+    void runWorker(std::size_t stageId)
+    {
+        using clock = std::chrono::steady_clock;
+
+        auto& stage = *stages[stageId];
+        StageStats local;
+
+        while (true)
+        {
+            auto start = clock::now();
+            auto item  = stage.input->pop();
+            auto ready = clock::now();
+            if (!item) break;
+
+            bool forward = false;
+            try
+            {
+                forward = stage.function(*item);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(errorMutex);
+                if (!firstError) firstError = std::current_exception();
+            }
+            auto done = clock::now();
+
+            if (forward && stageId + 1 < stages.size())
+                stages[stageId + 1]->input->push(std::move(*item));
+            else if (onFinished)
+                onFinished(*item);
+
+            local.items++;
+            local.idleTime += std::chrono::duration<double>(ready - start).count();
+            local.busyTime += std::chrono::duration<double>(done - ready).count();
+            local.blockedTime += std::chrono::duration<double>(clock::now() - done).count();
+        }
+
+        std::lock_guard lock(stage.statsMutex);
+        stage.stats.items += local.items;
+        stage.stats.idleTime += local.idleTime;
+        stage.stats.busyTime += local.busyTime;
+        stage.stats.blockedTime += local.blockedTime;
+    }
+
+public:
+    // adds a stage after all previously added ones
+    void addStage(std::string name, std::size_t workers, std::size_t queueDepth, StageFunction function)
+    {
+        auto stage              = std::make_unique<Stage>();
+        stage->stats.name       = std::move(name);
+        stage->stats.workers    = std::max<std::size_t>(workers, 1);
+        stage->function         = std::move(function);
+        stage->input            = std::make_unique<BoundedQueue<T>>(queueDepth);
+        stage->stats.queueDepth = stage->input->getCapacity();
+        stages.push_back(std::move(stage));
+    }
+
+    // called once for every item leaving the pipeline, either after the last stage or when a stage finished it early
+    void setFinishFunction(FinishFunction function) { onFinished = std::move(function); }
+
+    // feeds all items through the pipeline and blocks until every one of them is finished
+    void run(std::vector<T> items)
+    {
+        std::vector<std::vector<std::thread>> workers(stages.size());
+
+        for (std::size_t i = 0; i < stages.size(); i++)
+            for (std::size_t j = 0; j < stages[i]->stats.workers; j++)
+                workers[i].emplace_back(&Pipeline::runWorker, this, i);
+
+        for (auto& item : items)
+            stages.front()->input->push(std::move(item));
+
+        // shut down stage by stage, every stage has fully drained once its workers are joined
+        for (std::size_t i = 0; i < stages.size(); i++)
+        {
+            stages[i]->input->close();
+            for (auto& thread : workers[i])
+                thread.join();
+            stages[i]->stats.peakQueue = stages[i]->input->getPeakSize();
+        }
+
+        if (firstError) std::rethrow_exception(firstError);
+    }
+
+    std::vector<StageStats> getStats() const
+    {
+        std::vector<StageStats> stats;
+        for (auto& stage : stages)
+            stats.push_back(stage->stats);
+        return stats;
+    }
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+template<typename T> std::vector<T> readFileAsVector(std::filesystem::path path)
+{
+    std::vector<T> data;
+    std::ifstream slus(path, std::ios::binary);
+    auto size = std::filesystem::file_size(path);
+    data.resize(size / sizeof(T));
+    slus.read(reinterpret_cast<char*>(data.data()), size);
+    return data;
+}
@@ -0,0 +1,41 @@
+#include "SinCos.hpp"
+
+#include <cstdint>
+
+constexpr float FOUR_OVER_PI = 1.27323954473516f;
+// pi/4 split into three parts, so the reduction stays exact for large angles
+constexpr float PI_4_A = 0.78515625f;
+constexpr float PI_4_B = 2.4187564849853515625e-4f;
+constexpr float PI_4_C = 3.77489497744594108e-8f;
+
+void computeSinCos(std::span<const float> angles, std::span<float> sin, std::span<float> cos)
+{
+    for (std::size_t i = 0; i < angles.size(); i++)
+    {
+        auto x        = angles[i];
+        auto absolute = x < 0.0f ? -x : x;
+
+        // octant of the angle, rounded up to an even one, so z is within [-pi/4, pi/4]
+        auto octant = static_cast<int32_t>(absolute * FOUR_OVER_PI);
+        octant      = (octant + 1) & ~1;
+        auto y      = static_cast<float>(octant);
+        auto z      = ((absolute - y * PI_4_A) - y * PI_4_B) - y * PI_4_C;
+        auto zz     = z * z;
+
+        auto sinPoly = ((-1.9515295891e-4f * zz + 8.3321608736e-3f) * zz - 1.6666654611e-1f) * zz * z + z;
+        auto cosPoly = ((2.443315711809948e-5f * zz - 1.388731625493765e-3f) * zz + 4.166664568298827e-2f) * zz * zz -
+                       0.5f * zz + 1.0f;
+
+        // octants 2 and 6 swap the polynomials, the upper half of the circle flips the signs
+        auto quadrant = (octant >> 1) & 3;
+        auto swap     = (quadrant & 1) != 0;
+        auto sinValue = swap ? cosPoly : sinPoly;
+        auto cosValue = swap ? sinPoly : cosPoly;
+
+        auto sinNegative = (quadrant >= 2) != (x < 0.0f);
+        auto cosNegative = quadrant == 1 || quadrant == 2;
+
+        sin[i] = sinNegative ? -sinValue : sinValue;
+        cos[i] = cosNegative ? -cosValue : cosValue;
+    }
+}
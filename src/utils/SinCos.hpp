@@ -0,0 +1,9 @@
+#pragma once
+
+#include <span>
+
+/*
+ * Batched single precision sine and cosine, using the range reduction and polynomials of the Cephes sinf/cosf. The
+ * loop is branch free, so the compiler can vectorize it. Accurate to a few ULP for |angle| < 8192 radians.
+ */
+void computeSinCos(std::span<const float> angles, std::span<float> sin, std::span<float> cos);
@@ -0,0 +1,188 @@
+#include "GLTF.hpp"
+#include "PoseEvaluator.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+ * Compares PoseEvaluator against the animation channels the glTF export writes, for randomly generated MMD
+ * animations. Returns a non-zero exit code on the first mismatch.
+ */
+
+struct AnimationFile
+{
+    std::size_t boneCount;
+    std::vector<uint8_t> data;
+};
+
+static void write16(std::vector<uint8_t>& data, uint16_t value)
+{
+    data.push_back(value & 0xFF);
+    data.push_back(value >> 8);
+}
+
+static void write32(std::vector<uint8_t>& data, std::size_t offset, uint32_t value)
+{
+    for (std::size_t i = 0; i < 4; i++)
+        data[offset + i] = (value >> (i * 8)) & 0xFF;
+}
+
+// random animation data in the MMD format, including repeated time codes, loops, sounds and texture instructions
+static AnimationFile generateAnimations(uint32_t seed)
+{
+    std::mt19937 random(seed);
+    auto range = [&](int min, int max) { return std::uniform_int_distribution(min, max)(random); };
+
+    AnimationFile file{ static_cast<std::size_t>(range(2, 6)), {} };
+    auto animCount = range(1, 4);
+    file.data.resize(animCount * 4);
+
+    for (auto anim = 0; anim < animCount; anim++)
+    {
+        write32(file.data, anim * 4, static_cast<uint32_t>(file.data.size()));
+
+        bool hasScale = range(0, 1) == 1;
+        write16(file.data, static_cast<uint16_t>(range(0, 300) | (hasScale ? 0x8000 : 0)));
+        for (std::size_t bone = 1; bone < file.boneCount; bone++)
+            for (auto i = 0; i < (hasScale ? 9 : 6); i++)
+                write16(file.data, static_cast<uint16_t>(range(-5000, 5000)));
+
+        int time = 1;
+        for (auto i = range(0, 30); i > 0; i--)
+        {
+            constexpr int STEPS[] = { 0, 0, 1, 2, 5, 10, 40 };
+            time = std::min(0xFFF, time + STEPS[range(0, 6)]);
+
+            auto type = range(0, 9);
+            if (type < 6)
+            {
+                write16(file.data, static_cast<uint16_t>(time));
+                for (auto entries = range(1, 3); entries > 0; entries--)
+                {
+                    auto axes = range(1, 0x1FF);
+                    auto node = range(0, static_cast<int>(file.boneCount) - 1);
+                    write16(file.data, static_cast<uint16_t>(0x8000 | (axes << 6) | node));
+                    write16(file.data, static_cast<uint16_t>(range(1, 16)));
+                    for (auto bit = 0; bit < 9; bit++)
+                        if (axes & (1 << bit)) write16(file.data, static_cast<uint16_t>(range(-3000, 3000)));
+                }
+            }
+            else if (type == 6)
+                write16(file.data, static_cast<uint16_t>(0x1000 | range(0, 3)));
+            else if (type == 7)
+            {
+                write16(file.data, static_cast<uint16_t>(0x2000 | time));
+                write16(file.data, static_cast<uint16_t>(std::max(1, time - range(0, 20))));
+            }
+            else if (type == 8)
+            {
+                write16(file.data, static_cast<uint16_t>(0x3000 | time));
+                for (auto byte = 0; byte < 6; byte++)
+                    file.data.push_back(static_cast<uint8_t>(range(0, 255)));
+            }
+            else
+            {
+                write16(file.data, static_cast<uint16_t>(0x4000 | time));
+                file.data.push_back(static_cast<uint8_t>(range(0, 255)));
+                file.data.push_back(static_cast<uint8_t>(range(0, 255)));
+            }
+        }
+
+        write16(file.data, 0);
+    }
+
+    return file;
+}
+
+static bool matches(const FVector& actual, const FVector& expected)
+{
+    auto close = [](float a, float b) { return std::abs(a - b) <= 1e-3f * std::max(1.0f, std::abs(b)); };
+    return close(actual.x, expected.x) && close(actual.y, expected.y) && close(actual.z, expected.z);
+}
+
+static bool testChannels(uint32_t seed)
+{
+    auto file = generateAnimations(seed);
+    ReadBuffer buffer(file.data.data());
+    MMDAnimations animations(buffer, file.boneCount);
+
+    std::vector<NodeEntry> skeleton(file.boneCount, NodeEntry{ 0, 255 });
+    PoseEvaluator evaluator(animations, skeleton);
+
+    for (std::size_t anim = 0; anim < animations.anims.size(); anim++)
+    {
+        Animation data(animations.anims[anim]);
+        auto& nodes = data.getData();
+
+        for (std::size_t node = 0; node < nodes.size(); node++)
+        {
+            constexpr std::array<std::array<Axis, 3>, 3> CHANNELS{ {
+                { Axis::POS_X, Axis::POS_Y, Axis::POS_Z },
+                { Axis::ROT_X, Axis::ROT_Y, Axis::ROT_Z },
+                { Axis::SCALE_X, Axis::SCALE_Y, Axis::SCALE_Z },
+            } };
+
+            for (std::size_t channel = 0; channel < CHANNELS.size(); channel++)
+            {
+                auto& axes = CHANNELS[channel];
+                std::vector<float> times;
+                std::vector<FVector> values;
+                gatherChannel(nodes[node][axes[0]], nodes[node][axes[1]], nodes[node][axes[2]], times, values);
+
+                for (std::size_t key = 0; key < times.size(); key++)
+                {
+                    // later keys get replaced by the endless loop
+                    if (data.endlessStart >= 0 && times[key] > data.endlessEnd) break;
+
+                    auto transform = evaluator.sample(anim, times[key])[node];
+                    auto actual    = std::array{ transform.translation, transform.rotation, transform.scale }[channel];
+                    if (matches(actual, values[key])) continue;
+
+                    std::cout << std::format("Seed {}, animation {}, node {}, channel {}: mismatch at {}s\n",
+                                             seed,
+                                             anim,
+                                             node,
+                                             channel,
+                                             times[key]);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool testParentCycle()
+{
+    auto file = generateAnimations(1);
+    ReadBuffer buffer(file.data.data());
+    MMDAnimations animations(buffer, file.boneCount);
+
+    // every node is its own grandparent
+    std::vector<NodeEntry> skeleton;
+    for (std::size_t node = 0; node < file.boneCount; node++)
+        skeleton.push_back({ 0, static_cast<uint8_t>((node + 1) % file.boneCount) });
+
+    PoseEvaluator evaluator(animations, skeleton);
+    auto pose = evaluator.evaluate(0, 0.5f);
+    if (pose.world.size() == skeleton.size()) return true;
+
+    std::cout << "Parent cycle: wrong node count\n";
+    return false;
+}
+
+int main()
+{
+    for (uint32_t seed = 1; seed <= 500; seed++)
+        if (!testChannels(seed)) return EXIT_FAILURE;
+
+    if (!testParentCycle()) return EXIT_FAILURE;
+
+    std::cout << "PoseEvaluator matches the exported channels" << std::endl;
+    return EXIT_SUCCESS;
+}